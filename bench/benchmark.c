@@ -0,0 +1,285 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "camera.h"
+#include "display.h"
+#include "job.h"
+#include "mesh.h"
+#include "profile.h"
+#include "renderer.h"
+#include "span.h"
+#include "texture.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Deterministic benchmark of the whole frame (geometry and rasterization)
+///////////////////////////////////////////////////////////////////////////////
+// Every bundled asset is rendered headless in every render mode while the
+// mesh and the camera follow the same scripted path, driven by the frame
+// number only. So two runs on the same machine render exactly the same
+// frames and their timings can be compared. The path turns the mesh around
+// and brings it close enough to cross the near plane, so clipping is part of
+// the measurement too.
+//
+// One JSON object per line is written to stdout for every asset and mode:
+//
+//   {"asset":"f22","mode":"textured","min_ms":0.41,"avg_ms":0.47,"p99_ms":0.62,...}
+//
+// triangles is the number of triangles in the render queues of all the
+// measured frames (after culling and clipping), it only changes when the
+// geometry stage does. triangles_per_sec is based on it and pixels_per_sec on
+// the pixels of the frame buffer. The pipeline statistics are averages per
+// frame, overdraw is how many times every pixel was covered by a triangle.
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *assetNames[] = {"cube", "f22", "f117", "efa", "crab", "drone", "sphere"};
+#define NUM_ASSETS (int) (sizeof(assetNames) / sizeof(assetNames[0]))
+
+static const struct {
+    const char *name;
+    enum RenderMethod method;
+} renderModes[] = {
+    {"wire", RENDER_WIRE},
+    {"wire_vertex", RENDER_WIRE_VERTEX},
+    {"filled", RENDER_FILL_TRIANGLE},
+    {"filled_wire", RENDER_FILL_TRIANGLE_WIRE},
+    {"textured", RENDER_TEXTURED},
+    {"textured_wire", RENDER_TEXTURED_WIRE},
+    {"overdraw", RENDER_OVERDRAW},
+};
+#define NUM_RENDER_MODES (int) (sizeof(renderModes) / sizeof(renderModes[0]))
+
+typedef struct {
+    const char *assetsPath;
+    const char *onlyAsset;  // NULL for all of them
+    const char *onlyMode;   // NULL for all of them
+    const char *tracePath;  // NULL to not write a trace
+    int numThreads;  // 0 for one per core
+    int width;
+    int height;
+    int numFrames;
+    int numWarmupFrames;
+} BenchmarkOptions;
+
+static bool fileExists(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    fclose(file);
+    return true;
+}
+
+static bool loadAsset(const BenchmarkOptions *options, const char *name) {
+    char objPath[1024];
+    char pngPath[1024];
+    snprintf(objPath, sizeof(objPath), "%s/%s.obj", options->assetsPath, name);
+    snprintf(pngPath, sizeof(pngPath), "%s/%s.png", options->assetsPath, name);
+    if (!fileExists(objPath)) {
+        fprintf(stderr, "Skipping %s, %s not found.\n", name, objPath);
+        return false;
+    }
+
+    loadOBJFileData(objPath);
+    // not every asset has a texture, those skip the textured modes
+    if (fileExists(pngPath)) {
+        loadPNGTextureData(pngPath);
+    }
+    return true;
+}
+
+static void freeAsset(void) {
+    freeMesh();
+    // frees the texture, the placeholder does not count as one here
+    setMeshTexture(NULL);
+    meshTexture = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Place the mesh and the camera for frame number frame out of numFrames
+///////////////////////////////////////////////////////////////////////////////
+static void setScriptedScene(int frame, int numFrames) {
+    const float t = (float) frame / (float) numFrames;
+    const float angle = 2.0f * (float) M_PI * t;
+
+    mesh.rotation = vec3_new(0.3f * sinf(angle), angle, 0);
+    mesh.scale = vec3_new(1, 1, 1);
+    // from 5 units away to 2 and back, the bundled meshes are about 2 units
+    // big so the closest frames are clipped by the near plane
+    mesh.translation = vec3_new(0, 0, 5.0f - 3.0f * sinf((float) M_PI * t));
+
+    initCamera(vec3_new(0.5f * sinf(angle), 0.25f * sinf(2 * angle), 0), vec3_new(0, 0, 1));
+    rotateCameraYaw(0.1f * sinf(angle));
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void runBenchmark(const BenchmarkOptions *options, const char *asset, int mode, double *frameTimes) {
+    setRenderMethod(renderModes[mode].method);
+
+    for (int frame = 0; frame < options->numWarmupFrames; frame++) {
+        setScriptedScene(frame, options->numWarmupFrames);
+        processGeometry();
+        swapRenderQueues();
+        rasterizeFrame();
+    }
+
+    resetTotalStats();
+    const double counterFrequency = (double) SDL_GetPerformanceFrequency();
+    double totalSeconds = 0;
+    long long totalTriangles = 0;
+    for (int frame = 0; frame < options->numFrames; frame++) {
+        setScriptedScene(frame, options->numFrames);
+
+        const Uint64 start = SDL_GetPerformanceCounter();
+        PROFILE_BEGIN("frame");
+        processGeometry();
+        swapRenderQueues();
+        rasterizeFrame();
+        PROFILE_END();
+        const Uint64 end = SDL_GetPerformanceCounter();
+
+        frameTimes[frame] = (double) (end - start) / counterFrequency;
+        totalSeconds += frameTimes[frame];
+        totalTriangles += getNumTrianglesToRender();
+    }
+
+    qsort(frameTimes, options->numFrames, sizeof(double), compareDoubles);
+    const int p99Index = (int) ceil(0.99 * options->numFrames) - 1;
+    const double pixels = (double) options->width * options->height * options->numFrames;
+    const PipelineStats *stats = getTotalStats();
+    const double frames = options->numFrames;
+
+    printf(
+        "{\"asset\":\"%s\",\"mode\":\"%s\",\"width\":%d,\"height\":%d,\"frames\":%d,"
+        "\"threads\":%d,\"kernels\":\"%s\",\"triangles\":%lld,"
+        "\"min_ms\":%.4f,\"avg_ms\":%.4f,\"p99_ms\":%.4f,"
+        "\"triangles_per_sec\":%.0f,\"pixels_per_sec\":%.0f,"
+        "\"faces_culled\":%.1f,\"faces_rejected\":%.1f,\"faces_clipped\":%.1f,"
+        "\"depth_passed\":%.1f,\"depth_failed\":%.1f,\"texels_fetched\":%.1f,\"overdraw\":%.3f}\n",
+        asset, renderModes[mode].name, options->width, options->height, options->numFrames,
+        getJobThreadCount(), getSpanFunctionsName(), totalTriangles,
+        frameTimes[0] * 1000.0, totalSeconds / options->numFrames * 1000.0, frameTimes[p99Index] * 1000.0,
+        (double) totalTriangles / totalSeconds, pixels / totalSeconds,
+        stats->facesCulled / frames, stats->facesRejected / frames, stats->facesClipped / frames,
+        stats->depthPassed / frames, stats->depthFailed / frames, stats->texelsFetched / frames,
+        (double) (stats->depthPassed + stats->depthFailed) / pixels
+    );
+    fflush(stdout);
+}
+
+static void printUsage(const char *program) {
+    fprintf(
+        stderr,
+        "usage: %s [--assets DIR] [--asset NAME] [--mode NAME] [--size WIDTHxHEIGHT]\n"
+        "          [--frames N] [--warmup N] [--threads N] [--trace PATH]\n"
+        "  --assets DIR   directory with the .obj and .png files (default ../assets)\n"
+        "  --asset NAME   only benchmark this asset, e.g. f22\n"
+        "  --mode NAME    only benchmark this render mode: wire, wire_vertex, filled,\n"
+        "                 filled_wire, textured, textured_wire or overdraw\n"
+        "  --size WxH     size of the frames (default 800x600)\n"
+        "  --frames N     measured frames per asset and mode (default 300)\n"
+        "  --warmup N     frames rendered before measuring (default 10)\n"
+        "  --threads N    threads to render with, 1 renders everything on the main\n"
+        "                 thread (default one per core)\n"
+        "  --trace PATH   write the timings of every pipeline stage of the whole run\n"
+        "                 as a Chrome trace_event file, needs a build with\n"
+        "                 ENABLE_PROFILING\n",
+        program
+    );
+}
+
+int main(int argc, char *argv[]) {
+    BenchmarkOptions options = {
+        .assetsPath = "../assets",
+        .onlyAsset = NULL,
+        .onlyMode = NULL,
+        .tracePath = NULL,
+        .numThreads = 0,
+        .width = 800,
+        .height = 600,
+        .numFrames = 300,
+        .numWarmupFrames = 10,
+    };
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--assets") == 0 && hasValue) {
+            options.assetsPath = argv[++i];
+        } else if (strcmp(argv[i], "--asset") == 0 && hasValue) {
+            options.onlyAsset = argv[++i];
+        } else if (strcmp(argv[i], "--mode") == 0 && hasValue) {
+            options.onlyMode = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) {
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            options.numFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            options.numWarmupFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && hasValue) {
+            options.tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            options.numThreads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.numFrames <= 0 || options.numWarmupFrames < 0) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (options.tracePath && !isProfilingAvailable()) {
+        fprintf(stderr, "--trace needs a build with ENABLE_PROFILING.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!initializeHeadless(options.width, options.height)) {
+        return EXIT_FAILURE;
+    }
+    setCullMethod(CULL_BACKFACE);
+    initRenderer(options.numThreads);
+    if (options.tracePath) {
+        PROFILE_THREAD_NAME("main");
+        startProfiling();
+    }
+
+    double *frameTimes = malloc(sizeof(double) * options.numFrames);
+    for (int asset = 0; asset < NUM_ASSETS; asset++) {
+        if (options.onlyAsset && strcmp(options.onlyAsset, assetNames[asset]) != 0) {
+            continue;
+        }
+        if (!loadAsset(&options, assetNames[asset])) {
+            continue;
+        }
+        for (int mode = 0; mode < NUM_RENDER_MODES; mode++) {
+            if (options.onlyMode && strcmp(options.onlyMode, renderModes[mode].name) != 0) {
+                continue;
+            }
+            const bool isTextured = renderModes[mode].method == RENDER_TEXTURED ||
+                                    renderModes[mode].method == RENDER_TEXTURED_WIRE;
+            if (isTextured && !meshTexture) {
+                continue;
+            }
+            runBenchmark(&options, assetNames[asset], mode, frameTimes);
+        }
+        freeAsset();
+    }
+    free(frameTimes);
+    if (options.tracePath) {
+        writeProfileTrace(options.tracePath);
+    }
+
+    destroyRenderer();
+    destroyWindow();
+    return EXIT_SUCCESS;
+}
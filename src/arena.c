@@ -0,0 +1,100 @@
+#include "arena.h"
+
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Linear (bump) allocator for data that only lives for one frame
+///////////////////////////////////////////////////////////////////////////////
+// Allocating is moving an offset forward inside the current block, and all
+// the allocations are released together by putting the offset back to zero.
+// There is no free of a single allocation.
+//
+//   block: [ alloc 0 | alloc 1 | alloc 2 |......... free ..........]
+//                                        ^ offset
+//
+// When a frame needs more than the current block, a new block is chained in
+// front of it. At the next reset the chain is replaced by a single block as
+// big as the most the arena ever had to hold, so after the first frames the
+// arena settles to one block and no malloc at all.
+///////////////////////////////////////////////////////////////////////////////
+struct ArenaBlock {
+    ArenaBlock *previous;
+    size_t size;
+    size_t offset;
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+static size_t alignSize(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+}
+
+static ArenaBlock *createBlock(size_t size, ArenaBlock *previous) {
+    ArenaBlock *block = SDL_SIMDAlloc(sizeof(ArenaBlock) + size);
+    if (!block) {
+        fprintf(stderr, "Error allocating an arena block of %zu bytes.\n", size);
+        return NULL;
+    }
+    block->previous = previous;
+    block->size = size;
+    block->offset = 0;
+    return block;
+}
+
+static void freeBlocks(ArenaBlock *block) {
+    while (block) {
+        ArenaBlock *previous = block->previous;
+        SDL_SIMDFree(block);
+        block = previous;
+    }
+}
+
+void initArena(Arena *arena) {
+    arena->blocks = NULL;
+    arena->used = 0;
+    arena->highWater = 0;
+}
+
+void freeArena(Arena *arena) {
+    freeBlocks(arena->blocks);
+    initArena(arena);
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+    size = alignSize(size);
+
+    ArenaBlock *block = arena->blocks;
+    if (!block || block->size - block->offset < size) {
+        // at least double the arena, a frame that keeps growing chains few blocks
+        size_t blockSize = block ? block->size * 2 : ARENA_MIN_BLOCK_SIZE;
+        if (blockSize < size) {
+            blockSize = alignSize(size);
+        }
+        block = createBlock(blockSize, arena->blocks);
+        if (!block) {
+            return NULL;
+        }
+        arena->blocks = block;
+    }
+
+    void *allocation = block->data + block->offset;
+    block->offset += size;
+    arena->used += size;
+    return allocation;
+}
+
+void arenaReset(Arena *arena) {
+    if (arena->used > arena->highWater) {
+        arena->highWater = arena->used;
+    }
+    arena->used = 0;
+
+    ArenaBlock *block = arena->blocks;
+    if (block && block->previous) {
+        // coalesce the chain into one block that fits the whole high-water mark
+        freeBlocks(block);
+        arena->blocks = createBlock(alignSize(arena->highWater), NULL);
+    } else if (block) {
+        block->offset = 0;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef SDL2_SOFTWARE_RENDERER_ARENA_H
+#define SDL2_SOFTWARE_RENDERER_ARENA_H
+
+#include <stddef.h>
+
+// smallest block the arena asks malloc for
+#define ARENA_MIN_BLOCK_SIZE (64 * 1024)
+
+// every allocation is aligned to this, the least SDL_SIMDAlloc gives
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *blocks;  // the block allocations come from, linked to the older ones
+    size_t used;         // bytes allocated since the last reset, over all blocks
+    size_t highWater;    // most bytes used between two resets so far
+} Arena;
+
+void initArena(Arena *arena);
+void freeArena(Arena *arena);
+
+void *arenaAlloc(Arena *arena, size_t size);
+void arenaReset(Arena *arena);
+
+#endif //SDL2_SOFTWARE_RENDERER_ARENA_H
@@ -29,6 +29,35 @@ void* array_hold(void* array, int count, int item_size) {
     }
 }
 
+// make room for capacity items without changing the length, so the next
+// pushes up to capacity do not reallocate
+void* array_reserve(void* array, int capacity, int item_size) {
+    if (array == NULL) {
+        int raw_size = (sizeof(int) * 2) + (item_size * capacity);
+        int* base = (int*) malloc(raw_size);
+        base[0] = capacity;  // capacity
+        base[1] = 0;         // occupied
+        return base + 2;
+    } else if (capacity > ARRAY_CAPACITY(array)) {
+        int raw_size = sizeof(int) * 2 + item_size * capacity;
+        int* base = (int*) realloc(ARRAY_RAW_DATA(array), raw_size);
+        base[0] = capacity;
+        return base + 2;
+    }
+    return array;
+}
+
+// write the header of an array of count items at the start of memory, which
+// has room for ARRAY_HEADER_SIZE bytes and the items. For arrays that live in
+// memory array_hold does not own, like a mapped file: they can be read like
+// any array, but not grown or freed.
+void* array_place(void* memory, int count) {
+    int* base = (int*) memory;
+    base[0] = count;  // capacity
+    base[1] = count;  // occupied
+    return base + 2;
+}
+
 int array_length(void* array) {
     return (array != NULL) ? ARRAY_OCCUPIED(array) : 0;
 }
@@ -7,7 +7,12 @@
         (array)[array_length(array) - 1] = (value);                           \
     } while (0);
 
+// bytes in front of the items, where the capacity and the length are kept
+#define ARRAY_HEADER_SIZE ((int) sizeof(int) * 2)
+
 void* array_hold(void* array, int count, int item_size);
+void* array_reserve(void* array, int capacity, int item_size);
+void* array_place(void* memory, int count);
 int array_length(void* array);
 void array_free(void* array);
 
@@ -3,11 +3,17 @@
 //
 
 #include <math.h>
+#include <stdbool.h>
 #include "clipping.h"
 #include "vector.h"
 
 Plane frustumPlanes[NUM_FRUSTUM_PLANES];
 
+// the left, right, top and bottom planes of the guard band, same order as frustumPlanes
+Plane guardBandPlanes[NEAR_FRUSTUM_PLANE];
+
+static enum ClipMethod clipMethod = CLIP_GUARD_BAND;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Frustum planes are defined by a point and a normal vector
 ///////////////////////////////////////////////////////////////////////////////
@@ -65,6 +71,101 @@ void initFrustumPlanes(float fovX, float fovY, float zNear, float zFar) {
     frustumPlanes[FAR_FRUSTUM_PLANE].normal.x = 0;
     frustumPlanes[FAR_FRUSTUM_PLANE].normal.y = 0;
     frustumPlanes[FAR_FRUSTUM_PLANE].normal.z = -1;
+
+    // the guard band planes go through the camera too, but with a field of
+    // view GUARD_BAND_SCALE times wider on screen
+    float halfGuardBandX = atanf(GUARD_BAND_SCALE * tanf(fovX / 2));
+    float halfGuardBandY = atanf(GUARD_BAND_SCALE * tanf(fovY / 2));
+    float cosHalfGuardBandX = cosf(halfGuardBandX);
+    float sinHalfGuardBandX = sinf(halfGuardBandX);
+    float cosHalfGuardBandY = cosf(halfGuardBandY);
+    float sinHalfGuardBandY = sinf(halfGuardBandY);
+
+    guardBandPlanes[LEFT_FRUSTUM_PLANE].point = vec3_new(0, 0, 0);
+    guardBandPlanes[LEFT_FRUSTUM_PLANE].normal = vec3_new(cosHalfGuardBandX, 0, sinHalfGuardBandX);
+
+    guardBandPlanes[RIGHT_FRUSTUM_PLANE].point = vec3_new(0, 0, 0);
+    guardBandPlanes[RIGHT_FRUSTUM_PLANE].normal = vec3_new(-cosHalfGuardBandX, 0, sinHalfGuardBandX);
+
+    guardBandPlanes[TOP_FRUSTUM_PLANE].point = vec3_new(0, 0, 0);
+    guardBandPlanes[TOP_FRUSTUM_PLANE].normal = vec3_new(0, -cosHalfGuardBandY, sinHalfGuardBandY);
+
+    guardBandPlanes[BOTTOM_FRUSTUM_PLANE].point = vec3_new(0, 0, 0);
+    guardBandPlanes[BOTTOM_FRUSTUM_PLANE].normal = vec3_new(0, cosHalfGuardBandY, sinHalfGuardBandY);
+}
+
+void setClipMethod(enum ClipMethod method) {
+    clipMethod = method;
+}
+
+enum ClipMethod getClipMethod(void) {
+    return clipMethod;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Outcode of a view space vertex: bit N is set when the vertex is outside of
+// the frustum plane N (or exactly on it, the same as clipPolygonAgainstPlane).
+// The bits after those are set when the vertex is outside the guard band.
+///////////////////////////////////////////////////////////////////////////////
+// With the outcodes of its three vertices a triangle can skip clipping:
+//  - outcodeA & outcodeB & outcodeC != 0: all vertices are outside of the same
+//    plane, the triangle is not visible at all.
+//  - outcodeA | outcodeB | outcodeC == 0: all vertices are inside of all the
+//    planes, clipping would not change the triangle.
+// Only the triangles in between need to go through clipPolygon.
+///////////////////////////////////////////////////////////////////////////////
+static bool isOutsidePlane(Vec3 vertex, const Plane *plane) {
+    return vec3_dot(vec3_sub(vertex, plane->point), plane->normal) <= 0;
+}
+
+uint16_t computeFrustumOutcode(Vec3 vertex) {
+    uint16_t outcode = 0;
+    for (int plane = 0; plane < NUM_FRUSTUM_PLANES; plane++) {
+        if (isOutsidePlane(vertex, &frustumPlanes[plane])) {
+            outcode |= 1 << plane;
+        }
+    }
+    for (int plane = 0; plane < NEAR_FRUSTUM_PLANE; plane++) {
+        if (isOutsidePlane(vertex, &guardBandPlanes[plane])) {
+            outcode |= 1 << (GUARD_BAND_OUTCODE_SHIFT + plane);
+        }
+    }
+    return outcode;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pick the planes a triangle has to be clipped against, from the OR of the
+// outcodes of its vertices
+///////////////////////////////////////////////////////////////////////////////
+// Planes that no vertex is outside of never change the polygon, so only the
+// crossed ones are returned.
+//
+// With guard band clipping, the rasterizer takes care of the parts of the
+// triangle that are outside the left, right, top and bottom of the screen by
+// clamping to the viewport. As long as the triangle stays inside the guard
+// band its screen coordinates are still small enough for that, so those
+// planes are only clipped for the rare triangle that also leaves the guard
+// band on the same side. Near and far are always clipped: behind the camera
+// w changes sign and the projection does not work anymore.
+//
+//   +-----------------------------+
+//   |  guard band                 |
+//   |        +---------+          |
+//   |        | screen /|\         |  clipped only against near/far,
+//   |        |       / | \        |  the rasterizer clamps the rest
+//   |        +------/--+--\       |
+//   |              /_______\      |
+//   +-----------------------------+
+///////////////////////////////////////////////////////////////////////////////
+uint16_t selectClipPlanes(uint16_t outcodeUnion) {
+    const uint16_t crossedPlanes = outcodeUnion & FRUSTUM_OUTCODE_MASK;
+    if (clipMethod == CLIP_FRUSTUM) {
+        return crossedPlanes;
+    }
+
+    const uint16_t nearFarPlanes = (1 << NEAR_FRUSTUM_PLANE) | (1 << FAR_FRUSTUM_PLANE);
+    const uint16_t crossedGuardBand = outcodeUnion >> GUARD_BAND_OUTCODE_SHIFT;
+    return (crossedPlanes & nearFarPlanes) | (crossedPlanes & crossedGuardBand);
 }
 
 Polygon createPolygonFromTriangle(
@@ -156,12 +257,16 @@ void clipPolygonAgainstPlane(Polygon *polygon, FrustumPlane plane) {
 
 
 void clipPolygon(Polygon *polygon) {
-    clipPolygonAgainstPlane(polygon, LEFT_FRUSTUM_PLANE);
-    clipPolygonAgainstPlane(polygon, RIGHT_FRUSTUM_PLANE);
-    clipPolygonAgainstPlane(polygon, TOP_FRUSTUM_PLANE);
-    clipPolygonAgainstPlane(polygon, BOTTOM_FRUSTUM_PLANE);
-    clipPolygonAgainstPlane(polygon, NEAR_FRUSTUM_PLANE);
-    clipPolygonAgainstPlane(polygon, FAR_FRUSTUM_PLANE);
+    clipPolygonAgainstPlanes(polygon, FRUSTUM_OUTCODE_MASK);
+}
+
+// clip only against the frustum planes whose bit is set in planes
+void clipPolygonAgainstPlanes(Polygon *polygon, uint16_t planes) {
+    for (int plane = 0; plane < NUM_FRUSTUM_PLANES; plane++) {
+        if (planes & (1 << plane)) {
+            clipPolygonAgainstPlane(polygon, plane);
+        }
+    }
 }
 
 void createTrianglesFromPolygon(Polygon *polygon, Triangle triangles[], int *numTriangles) {
@@ -5,6 +5,8 @@
 #ifndef SDL2_SOFTWARE_RENDERER_CLIPPING_H
 #define SDL2_SOFTWARE_RENDERER_CLIPPING_H
 
+#include <stdint.h>
+
 #include "vector.h"
 #include "triangle.h"
 
@@ -21,6 +23,18 @@ typedef enum {
     NUM_FRUSTUM_PLANES
 } FrustumPlane;
 
+// bits NUM_FRUSTUM_PLANES and up of an outcode are the sides of the guard band
+#define GUARD_BAND_OUTCODE_SHIFT NUM_FRUSTUM_PLANES
+#define FRUSTUM_OUTCODE_MASK ((1 << NUM_FRUSTUM_PLANES) - 1)
+
+// how much bigger than the viewport the guard band is, in each direction
+#define GUARD_BAND_SCALE 4.0f
+
+enum ClipMethod {
+    CLIP_FRUSTUM,
+    CLIP_GUARD_BAND,
+};
+
 typedef struct {
     Vec3 point;
     Vec3 normal;
@@ -34,6 +48,12 @@ typedef struct {
 
 void initFrustumPlanes(float fovX, float fovY, float zNear, float zFar);
 
+void setClipMethod(enum ClipMethod method);
+enum ClipMethod getClipMethod(void);
+
+uint16_t computeFrustumOutcode(Vec3 vertex);
+uint16_t selectClipPlanes(uint16_t outcodeUnion);
+
 Polygon createPolygonFromTriangle(
     Vec3 v0,
     Vec3 v1,
@@ -44,6 +64,7 @@ Polygon createPolygonFromTriangle(
 );
 
 void clipPolygon(Polygon *polygon);
+void clipPolygonAgainstPlanes(Polygon *polygon, uint16_t planes);
 
 void createTrianglesFromPolygon(Polygon *polygon, Triangle triangles[], int *numTriangles);
 
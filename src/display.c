@@ -1,9 +1,25 @@
 #include "display.h"
 
+#include <string.h>
+
 static SDL_Window *window = NULL;
 static SDL_Renderer *renderer = NULL;
 
+///////////////////////////////////////////////////////////////////////////////
+// The frame is rasterized straight into the pixels of colorBufferTexture:
+// lockColorBuffer points colorBuffer at the memory SDL_LockTexture hands out
+// and renderColorBuffer unlocks it to present, so there is no copy of the
+// whole frame into the texture. Rows of the locked texture can be padded,
+// colorBufferPitch is the distance between rows in pixels and every access
+// to the color buffer has to go through it, never through windowWidth.
+//
+// The malloc'd fallbackColorBuffer is used by the headless mode, when the
+// texture cannot be locked, and between frames.
+///////////////////////////////////////////////////////////////////////////////
 static uint32_t *colorBuffer = NULL;
+static uint32_t *fallbackColorBuffer = NULL;
+static int colorBufferPitch = 0;
+static bool isColorBufferLocked = false;
 static float *zBuffer = NULL;
 
 static SDL_Texture *colorBufferTexture = NULL;
@@ -19,6 +35,9 @@ static enum RenderMethod renderMethod = RENDER_TEXTURED;
 
 bool startFullScreen = false;
 
+// rendering only into colorBuffer, without a window to present it to
+static bool isHeadless = false;
+
 bool initializeWindow(void) {
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         fprintf(stderr, "Error initializing SDL.\n");
@@ -56,7 +75,9 @@ bool initializeWindow(void) {
     }
 
     // Allocate the required memory in bytes to hold the color buffer
-    colorBuffer = (uint32_t *) malloc(sizeof(uint32_t) * windowWidth * windowHeight);
+    fallbackColorBuffer = (uint32_t *) malloc(sizeof(uint32_t) * windowWidth * windowHeight);
+    colorBuffer = fallbackColorBuffer;
+    colorBufferPitch = windowWidth;
     zBuffer = (float *) malloc(sizeof(float) * windowWidth * windowHeight);
 
     // // Creating a SDL texture that is used to display the color buffer
@@ -71,10 +92,91 @@ bool initializeWindow(void) {
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Offscreen rendering for machines without a display: only the color and z
+// buffers are allocated, no window, renderer or texture. SDL is only started
+// for its threads, timers and CPU info. Frames are read back with
+// saveColorBufferPPM or copyColorBuffer instead of being presented.
+///////////////////////////////////////////////////////////////////////////////
+bool initializeHeadless(int width, int height) {
+    if (SDL_Init(0) != 0) {
+        fprintf(stderr, "Error initializing SDL.\n");
+        return false;
+    }
+    // the guard band around the frame still has to fit the int16 coordinates of the rasterizer
+    if (width <= 0 || height <= 0 || width > INT16_MAX / 4 || height > INT16_MAX / 4) {
+        fprintf(stderr, "Invalid headless frame size %dx%d.\n", width, height);
+        return false;
+    }
+
+    isHeadless = true;
+    windowWidth = width;
+    windowHeight = height;
+
+    fallbackColorBuffer = (uint32_t *) malloc(sizeof(uint32_t) * windowWidth * windowHeight);
+    colorBuffer = fallbackColorBuffer;
+    colorBufferPitch = windowWidth;
+    zBuffer = (float *) malloc(sizeof(float) * windowWidth * windowHeight);
+    if (!colorBuffer || !zBuffer) {
+        fprintf(stderr, "Error allocating the %dx%d frame buffers.\n", width, height);
+        return false;
+    }
+    return true;
+}
+
+bool saveColorBufferPPM(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error opening %s to save the frame.\n", path);
+        return false;
+    }
+
+    // colorBuffer is SDL_PIXELFORMAT_RGBA32, the bytes of every pixel are R, G, B, A in memory
+    fprintf(file, "P6\n%d %d\n255\n", windowWidth, windowHeight);
+    uint8_t *row = malloc(3 * windowWidth);
+    for (int y = 0; y < windowHeight; y++) {
+        const uint8_t *pixels = (const uint8_t *) &colorBuffer[colorBufferPitch * y];
+        for (int x = 0; x < windowWidth; x++) {
+            row[3 * x + 0] = pixels[4 * x + 0];
+            row[3 * x + 1] = pixels[4 * x + 1];
+            row[3 * x + 2] = pixels[4 * x + 2];
+        }
+        fwrite(row, 3, windowWidth, file);
+    }
+    free(row);
+
+    const bool isWritten = !ferror(file);
+    if (fclose(file) != 0 || !isWritten) {
+        fprintf(stderr, "Error writing the frame to %s.\n", path);
+        return false;
+    }
+    return true;
+}
+
+// copy the frame into a caller buffer of windowHeight rows, pitch bytes apart
+void copyColorBuffer(uint32_t *destination, int pitch) {
+    for (int y = 0; y < windowHeight; y++) {
+        memcpy(
+            (uint8_t *) destination + (size_t) pitch * y,
+            &colorBuffer[colorBufferPitch * y],
+            sizeof(uint32_t) * windowWidth
+        );
+    }
+}
+
+bool isHeadlessDisplay(void) {
+    return isHeadless;
+}
+
 void drawGrid(void) {
-    for (int y = 0; y < windowHeight; y += 10) {
+    drawGridRows(0, windowHeight - 1);
+}
+
+// the part of the grid in the rows minY to maxY, inclusive
+void drawGridRows(int minY, int maxY) {
+    for (int y = (minY + 9) / 10 * 10; y <= maxY; y += 10) {
         for (int x = 0; x < windowWidth; x += 10) {
-            colorBuffer[(windowWidth * y) + x] = 0xFF444444;
+            colorBuffer[(colorBufferPitch * y) + x] = 0xFF444444;
         }
     }
 }
@@ -98,7 +200,7 @@ void drawPixel(const int x, const int y, const uint32_t color) {
         fprintf(stderr, "colorBuffer is not initialized.\n");
         return;
     }
-    colorBuffer[(windowWidth * y) + x] = color;
+    colorBuffer[(colorBufferPitch * y) + x] = color;
 }
 
 void drawLine(const int x0, const int y0, const int x1, const int y1, const uint32_t color) {
@@ -129,44 +231,144 @@ void drawTriangle(const Vec2 pointA, const Vec2 pointB, const Vec2 pointC, const
     drawLinePoint(pointC, pointA, color);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Start drawing a frame into the texture, call before anything is drawn. The
+// locked pixels are write-only as far as SDL is concerned and hold garbage,
+// so the frame has to be cleared first. Falls back to the malloc'd buffer
+// when the texture cannot be locked.
+///////////////////////////////////////////////////////////////////////////////
+void lockColorBuffer(void) {
+    if (isHeadless || isColorBufferLocked) {
+        return;
+    }
+    void *pixels = NULL;
+    int pitch = 0;
+    if (SDL_LockTexture(colorBufferTexture, NULL, &pixels, &pitch) != 0) {
+        return;
+    }
+    if (pitch % sizeof(uint32_t) != 0) {
+        // rows that do not start on a whole pixel, this never happens for RGBA32
+        SDL_UnlockTexture(colorBufferTexture);
+        return;
+    }
+    isColorBufferLocked = true;
+    colorBuffer = pixels;
+    colorBufferPitch = pitch / (int) sizeof(uint32_t);
+}
+
 void renderColorBuffer(void) {
-    SDL_UpdateTexture(
-        colorBufferTexture,
-        NULL,
-        colorBuffer,
-        windowWidth * sizeof(uint32_t)
-    );
+    if (isHeadless) {
+        return;
+    }
+    if (isColorBufferLocked) {
+        SDL_UnlockTexture(colorBufferTexture);
+        isColorBufferLocked = false;
+        colorBuffer = fallbackColorBuffer;
+        colorBufferPitch = windowWidth;
+    } else {
+        SDL_UpdateTexture(
+            colorBufferTexture,
+            NULL,
+            colorBuffer,
+            colorBufferPitch * sizeof(uint32_t)
+        );
+    }
     SDL_RenderCopy(renderer, colorBufferTexture, NULL, NULL);
     SDL_RenderPresent(renderer);
 }
 
 void clearColorBuffer(const uint32_t color) {
+    clearColorBufferRows(color, 0, windowHeight - 1);
+}
+
+// the frame buffers can also be cleared in bands of rows minY to maxY, inclusive
+void clearColorBufferRows(const uint32_t color, int minY, int maxY) {
     if (colorBuffer == NULL) {
         return;
     }
-    for (int i = 0; i < windowHeight * windowWidth; i++) {
-        colorBuffer[i] = color;
+    for (int y = minY; y <= maxY; y++) {
+        uint32_t *row = &colorBuffer[colorBufferPitch * y];
+        for (int x = 0; x < windowWidth; x++) {
+            row[x] = color;
+        }
     }
 }
 
 void clearZBuffer(void) {
+    clearZBufferRows(0, windowHeight - 1);
+}
+
+void clearZBufferRows(int minY, int maxY) {
     if (zBuffer == NULL) {
         return;
     }
-    for (int i = 0; i < windowHeight * windowWidth; i++) {
+    for (int i = minY * windowWidth; i < (maxY + 1) * windowWidth; i++) {
         // we have a left-handed coordinate system, so the zBuffer is filled with 1s
         zBuffer[i] = 1.f; // 1 is the farthest point in the zBuffer
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Overdraw heatmap
+///////////////////////////////////////////////////////////////////////////////
+// In RENDER_OVERDRAW the color buffer is cleared to 0 and the rasterizer adds
+// one to a pixel every time a triangle shades it, so after rasterizing it
+// holds counts instead of colors. This turns the counts into false colors:
+//
+//   0 black, 1 blue, 2 cyan, 3 green, 4 yellow, 5 orange, 6 red,
+//   7 magenta, 8 or more white
+//
+// Anything above 1 is work a front-to-back order or an early depth pass
+// would have saved.
+///////////////////////////////////////////////////////////////////////////////
+void shadeOverdrawHeatmap(void) {
+    shadeOverdrawHeatmapRows(0, windowHeight - 1);
+}
+
+void shadeOverdrawHeatmapRows(int minY, int maxY) {
+    // in the byte order of SDL_PIXELFORMAT_RGBA32, 0xAABBGGRR
+    static const uint32_t heatmap[] = {
+        0xFF000000,
+        0xFFFF0000,
+        0xFFFFFF00,
+        0xFF00FF00,
+        0xFF00FFFF,
+        0xFF0080FF,
+        0xFF0000FF,
+        0xFFFF00FF,
+        0xFFFFFFFF,
+    };
+    const uint32_t maxCount = sizeof(heatmap) / sizeof(heatmap[0]) - 1;
+
+    if (colorBuffer == NULL) {
+        return;
+    }
+    for (int y = minY; y <= maxY; y++) {
+        uint32_t *row = &colorBuffer[colorBufferPitch * y];
+        for (int x = 0; x < windowWidth; x++) {
+            const uint32_t count = row[x];
+            row[x] = heatmap[count < maxCount ? count : maxCount];
+        }
+    }
+}
+
 void destroyWindow(void) {
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    if (isColorBufferLocked) {
+        SDL_UnlockTexture(colorBufferTexture);
+        isColorBufferLocked = false;
+    }
+    if (!isHeadless) {
+        SDL_DestroyTexture(colorBufferTexture);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+    }
     SDL_Quit();
 
-    free(colorBuffer);
+    free(fallbackColorBuffer);
     free(zBuffer);
-    SDL_DestroyTexture(colorBufferTexture);
+    fallbackColorBuffer = NULL;
+    colorBuffer = NULL;
+    zBuffer = NULL;
 }
 
 int getWindowHeight(void) {
@@ -214,6 +416,23 @@ bool shouldRenderWireVertex(void) {
     return renderMethod == RENDER_WIRE_VERTEX;
 }
 
+bool shouldRenderOverdraw(void) {
+    return renderMethod == RENDER_OVERDRAW;
+}
+
+uint32_t *getColorBuffer(void) {
+    return colorBuffer;
+}
+
+// the distance between two rows of getColorBuffer, in pixels
+int getColorBufferPitch(void) {
+    return colorBufferPitch;
+}
+
+float *getZBuffer(void) {
+    return zBuffer;
+}
+
 float getZBufferAt(int x, int y) {
     if (x < 0 || x >= windowWidth || y >= windowHeight || y < 0) {
         return 1.f;
@@ -21,6 +21,7 @@ enum RenderMethod {
     RENDER_FILL_TRIANGLE_WIRE,
     RENDER_TEXTURED,
     RENDER_TEXTURED_WIRE,
+    RENDER_OVERDRAW,
 };
 
 int getWindowWidth(void);
@@ -39,20 +40,35 @@ bool shouldRenderFilledTriangle(void);
 bool shouldRenderTexturedTriangle(void);
 bool shouldRenderWireframe(void);
 bool shouldRenderWireVertex(void);
+bool shouldRenderOverdraw(void);
 bool initializeWindow(void);
+bool initializeHeadless(int width, int height);
+bool isHeadlessDisplay(void);
 
 void drawGrid(void);
+void drawGridRows(int minY, int maxY);
 void drawRect(int x, int y, int width, int height, uint32_t color);
 void drawPixel(int x, int y, uint32_t color);
 void drawLine(int x0, int y0, int x1, int y1, uint32_t color);
 void drawLinePoint(Vec2 point0, Vec2 point1, uint32_t color);
 void drawTriangle(Vec2 pointA, Vec2 pointB, Vec2 pointC, uint32_t color);
 
+void lockColorBuffer(void);
 void renderColorBuffer(void);
 void clearColorBuffer(uint32_t color);
+void clearColorBufferRows(uint32_t color, int minY, int maxY);
 void clearZBuffer(void);
+void clearZBufferRows(int minY, int maxY);
+void shadeOverdrawHeatmap(void);
+void shadeOverdrawHeatmapRows(int minY, int maxY);
 void destroyWindow(void);
 
+bool saveColorBufferPPM(const char *path);
+void copyColorBuffer(uint32_t *destination, int pitch);
+
+uint32_t *getColorBuffer(void);
+int getColorBufferPitch(void);
+float *getZBuffer(void);
 float getZBufferAt(int x, int y);
 void updateZBuffer(int x, int y, float value);
 
@@ -0,0 +1,302 @@
+#include "job.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+
+#include "profile.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Work-stealing job system
+///////////////////////////////////////////////////////////////////////////////
+// Every worker thread owns a deque of jobs. A worker that starts a batch
+// pushes it onto its own deque and pops from the newest end, while idle
+// workers steal from the oldest end of the others. Threads that are not
+// workers, like the main and the geometry threads, push their batches onto
+// the shared injection queue instead, which everybody takes from in order.
+//
+//     worker 0      [j5 j6 j7]  <- pop newest
+//     worker 1      [j0 j1]     <- pop newest
+//        steal oldest ^
+//     injection     [t0 t1 t2 t3 ...]
+//
+// The thread that runs a batch does not sit idle while it waits: it runs
+// jobs too, its own or anybody's, until every job of its batch is done.
+// Workers with nothing to take sleep on a condition variable that is woken
+// up for every new batch.
+//
+// The deques are guarded by a spinlock each. The jobs are whole tiles and
+// chunks of thousands of faces, so the locks are never the bottleneck.
+//
+// With a single thread there are no workers and runJobs just calls the jobs
+// in order on the calling thread, so the results can be compared bit by bit.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    JobFunction function;
+    void *data;
+    int index;
+    SDL_atomic_t *pending;  // jobs of the batch not done yet, lives in runJobs
+} Job;
+
+typedef struct {
+    SDL_SpinLock lock;
+    Job *jobs;     // ring buffer
+    int capacity;  // a power of two
+    int head;      // the oldest job
+    int count;
+} JobDeque;
+
+typedef struct {
+    JobDeque deque;
+    SDL_Thread *thread;
+    int index;
+    char padding[64];  // keeps the locks of two workers off the same cache line
+} JobWorker;
+
+#define JOB_DEQUE_MIN_CAPACITY 256
+
+static JobWorker *workers = NULL;
+static int numWorkers = 0;
+static JobDeque injectionQueue;
+
+// jobs pushed to any deque and not taken yet
+static SDL_atomic_t numQueuedJobs;
+static SDL_mutex *wakeMutex = NULL;
+static SDL_cond *wakeCondition = NULL;
+static bool isStopping = false;
+
+// the worker running on this thread, NULL for the threads that are not workers
+static _Thread_local JobWorker *currentWorker = NULL;
+
+static bool initJobDeque(JobDeque *deque) {
+    deque->lock = 0;
+    deque->jobs = malloc(sizeof(Job) * JOB_DEQUE_MIN_CAPACITY);
+    deque->capacity = JOB_DEQUE_MIN_CAPACITY;
+    deque->head = 0;
+    deque->count = 0;
+    return deque->jobs != NULL;
+}
+
+static void freeJobDeque(JobDeque *deque) {
+    free(deque->jobs);
+    deque->jobs = NULL;
+    deque->capacity = 0;
+    deque->count = 0;
+}
+
+// the deque has to be locked, returns false if there is no memory left to grow it
+static bool pushJob(JobDeque *deque, Job job) {
+    if (deque->count == deque->capacity) {
+        Job *jobs = malloc(sizeof(Job) * deque->capacity * 2);
+        if (!jobs) {
+            return false;
+        }
+        for (int i = 0; i < deque->count; i++) {
+            jobs[i] = deque->jobs[(deque->head + i) & (deque->capacity - 1)];
+        }
+        free(deque->jobs);
+        deque->jobs = jobs;
+        deque->capacity *= 2;
+        deque->head = 0;
+    }
+    deque->jobs[(deque->head + deque->count) & (deque->capacity - 1)] = job;
+    deque->count++;
+    return true;
+}
+
+static bool popNewestJob(JobDeque *deque, Job *job) {
+    SDL_AtomicLock(&deque->lock);
+    const bool hasJob = deque->count > 0;
+    if (hasJob) {
+        deque->count--;
+        *job = deque->jobs[(deque->head + deque->count) & (deque->capacity - 1)];
+    }
+    SDL_AtomicUnlock(&deque->lock);
+    return hasJob;
+}
+
+static bool popOldestJob(JobDeque *deque, Job *job) {
+    SDL_AtomicLock(&deque->lock);
+    const bool hasJob = deque->count > 0;
+    if (hasJob) {
+        *job = deque->jobs[deque->head];
+        deque->head = (deque->head + 1) & (deque->capacity - 1);
+        deque->count--;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+    return hasJob;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Find a job for the thread of self (NULL when it is not a worker): its own
+// newest job first, then the injection queue, then the oldest job of the
+// other workers
+///////////////////////////////////////////////////////////////////////////////
+static bool takeJob(JobWorker *self, Job *job) {
+    if (SDL_AtomicGet(&numQueuedJobs) <= 0) {
+        return false;
+    }
+
+    bool hasJob = (self && popNewestJob(&self->deque, job)) || popOldestJob(&injectionQueue, job);
+    const int first = self ? self->index + 1 : 0;
+    for (int i = 0; !hasJob && i < numWorkers; i++) {
+        JobWorker *victim = &workers[(first + i) % numWorkers];
+        if (victim != self) {
+            hasJob = popOldestJob(&victim->deque, job);
+        }
+    }
+    if (hasJob) {
+        SDL_AtomicAdd(&numQueuedJobs, -1);
+    }
+    return hasJob;
+}
+
+static void runJob(const Job *job) {
+    job->function(job->data, job->index);
+    if (SDL_AtomicAdd(job->pending, -1) == 1) {
+        // the last job of the batch, wake up the thread waiting for it
+        SDL_LockMutex(wakeMutex);
+        SDL_CondBroadcast(wakeCondition);
+        SDL_UnlockMutex(wakeMutex);
+    }
+}
+
+static int jobWorker(void *data) {
+    JobWorker *self = data;
+    currentWorker = self;
+    PROFILE_THREAD_NAME("job worker");
+    for (;;) {
+        Job job;
+        if (takeJob(self, &job)) {
+            runJob(&job);
+            continue;
+        }
+
+        SDL_LockMutex(wakeMutex);
+        while (SDL_AtomicGet(&numQueuedJobs) <= 0 && !isStopping) {
+            SDL_CondWait(wakeCondition, wakeMutex);
+        }
+        const bool stop = isStopping;
+        SDL_UnlockMutex(wakeMutex);
+        if (stop) {
+            return 0;
+        }
+    }
+}
+
+bool initJobSystem(int numThreads) {
+    if (numThreads <= 0) {
+        numThreads = SDL_GetCPUCount();
+    }
+
+    SDL_AtomicSet(&numQueuedJobs, 0);
+    isStopping = false;
+    wakeMutex = SDL_CreateMutex();
+    wakeCondition = SDL_CreateCond();
+    if (!wakeMutex || !wakeCondition || !initJobDeque(&injectionQueue)) {
+        fprintf(stderr, "Error creating the job system.\n");
+        return false;
+    }
+
+    numWorkers = 0;
+    workers = calloc(SDL_max(numThreads - 1, 1), sizeof(JobWorker));
+    for (int i = 0; i < numThreads - 1; i++) {
+        JobWorker *worker = &workers[numWorkers];
+        worker->index = numWorkers;
+        if (!initJobDeque(&worker->deque)) {
+            fprintf(stderr, "Error creating job worker %d, continuing with %d.\n", i, numWorkers);
+            break;
+        }
+        worker->thread = SDL_CreateThread(jobWorker, "jobWorker", worker);
+        if (!worker->thread) {
+            freeJobDeque(&worker->deque);
+            fprintf(stderr, "Error creating job worker thread, continuing with %d.\n", numWorkers);
+            break;
+        }
+        numWorkers++;
+    }
+    return true;
+}
+
+void destroyJobSystem(void) {
+    if (wakeMutex) {
+        SDL_LockMutex(wakeMutex);
+        isStopping = true;
+        SDL_CondBroadcast(wakeCondition);
+        SDL_UnlockMutex(wakeMutex);
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        SDL_WaitThread(workers[i].thread, NULL);
+        freeJobDeque(&workers[i].deque);
+    }
+    free(workers);
+    workers = NULL;
+    numWorkers = 0;
+    freeJobDeque(&injectionQueue);
+
+    SDL_DestroyCond(wakeCondition);
+    SDL_DestroyMutex(wakeMutex);
+    wakeCondition = NULL;
+    wakeMutex = NULL;
+}
+
+int getJobThreadCount(void) {
+    return numWorkers + 1;
+}
+
+void runJobs(JobFunction function, void *data, int count) {
+    if (count <= 0) {
+        return;
+    }
+    // nobody could help with a single job, skip waking up the workers
+    if (numWorkers == 0 || count == 1) {
+        for (int i = 0; i < count; i++) {
+            function(data, i);
+        }
+        return;
+    }
+
+    SDL_atomic_t pending;
+    SDL_AtomicSet(&pending, count);
+
+    // counted before they are pushed, so a thread that sees no queued jobs
+    // can safely go to sleep
+    SDL_AtomicAdd(&numQueuedJobs, count);
+    JobDeque *deque = currentWorker ? &currentWorker->deque : &injectionQueue;
+    int numPushed = 0;
+    SDL_AtomicLock(&deque->lock);
+    while (numPushed < count) {
+        const Job job = {.function = function, .data = data, .index = numPushed, .pending = &pending};
+        if (!pushJob(deque, job)) {
+            break;
+        }
+        numPushed++;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+    SDL_AtomicAdd(&numQueuedJobs, numPushed - count);
+
+    SDL_LockMutex(wakeMutex);
+    SDL_CondBroadcast(wakeCondition);
+    SDL_UnlockMutex(wakeMutex);
+
+    // the jobs that did not fit in the deque run right here
+    for (int i = numPushed; i < count; i++) {
+        function(data, i);
+        SDL_AtomicAdd(&pending, -1);
+    }
+
+    // help until the whole batch is done
+    while (SDL_AtomicGet(&pending) > 0) {
+        Job job;
+        if (takeJob(currentWorker, &job)) {
+            runJob(&job);
+            continue;
+        }
+
+        SDL_LockMutex(wakeMutex);
+        while (SDL_AtomicGet(&pending) > 0 && SDL_AtomicGet(&numQueuedJobs) <= 0) {
+            SDL_CondWait(wakeCondition, wakeMutex);
+        }
+        SDL_UnlockMutex(wakeMutex);
+    }
+}
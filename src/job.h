@@ -0,0 +1,19 @@
+#ifndef SDL2_SOFTWARE_RENDERER_JOB_H
+#define SDL2_SOFTWARE_RENDERER_JOB_H
+
+#include <stdbool.h>
+
+// one job of a batch, index goes from 0 to the size of the batch - 1
+typedef void (*JobFunction)(void *data, int index);
+
+// numThreads includes the calling thread, 0 starts one thread per core
+bool initJobSystem(int numThreads);
+void destroyJobSystem(void);
+int getJobThreadCount(void);
+
+// run function(data, index) for every index of the batch, and help running
+// jobs until all of them are done. Can be called from any thread, several
+// threads can run batches at the same time.
+void runJobs(JobFunction function, void *data, int count);
+
+#endif //SDL2_SOFTWARE_RENDERER_JOB_H
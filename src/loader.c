@@ -0,0 +1,218 @@
+#include "loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "mesh.h"
+#include "profile.h"
+#include "texture.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Asynchronous asset loading
+///////////////////////////////////////////////////////////////////////////////
+// Meshes and textures are loaded on a thread of their own, so the render
+// loop never waits for a file. The loader takes the requests in order,
+// parses the OBJ into a mesh of its own, decodes the PNG, and publishes
+// both at once with an atomic swap of readyAsset:
+//
+//   loader thread   | load A ........ | publish A | load B ...
+//   main thread     | frame | frame | frame | apply A | frame | ...
+//
+// The main thread picks the asset up between frames, when neither the
+// geometry nor the rasterization is running, and until then keeps drawing
+// what it had, the placeholder cube at first. An asset nobody picked up yet
+// is replaced by the next one that finishes.
+//
+// The new mesh is used by the geometry of the next frame right away, but
+// the frame being rasterized meanwhile still holds triangles of the old
+// mesh. So the texture changes one frame later, when the first triangles of
+// the new mesh reach the rasterizer.
+//
+// The loader parses without the job system and at a low priority, the
+// render jobs go first.
+///////////////////////////////////////////////////////////////////////////////
+#define ASSET_LOAD_QUEUE_SIZE 8
+#define ASSET_PATH_SIZE 1024
+
+typedef struct {
+    char objFileName[ASSET_PATH_SIZE];
+    char pngFileName[ASSET_PATH_SIZE];  // empty for no texture
+} AssetRequest;
+
+typedef struct {
+    Mesh mesh;
+    TextureImage texture;  // no pixels for no texture
+} LoadedAsset;
+
+static SDL_Thread *loaderThread = NULL;
+static SDL_mutex *loaderMutex = NULL;
+static SDL_cond *loaderCondition = NULL;  // new requests, idle loader or stopping
+static bool isLoaderStopping = false;
+
+// guarded by loaderMutex
+static AssetRequest requests[ASSET_LOAD_QUEUE_SIZE];
+static int firstRequest = 0;
+static int numRequests = 0;
+static bool isLoading = false;
+
+// the last asset loaded and not applied yet, swapped atomically
+static void *readyAsset = NULL;
+
+// main thread only, the texture of the last applied asset waits for a frame
+static TextureImage pendingTexture = {.pixels = NULL, .width = 0, .height = 0};
+static bool hasPendingTexture = false;
+
+static void freeLoadedAsset(LoadedAsset *asset) {
+    freeMeshData(&asset->mesh);
+    freeTextureImage(&asset->texture);
+    free(asset);
+}
+
+static void loadAsset(const AssetRequest *request) {
+    PROFILE_BEGIN("load asset");
+    LoadedAsset *asset = calloc(1, sizeof(LoadedAsset));
+    if (!asset || !loadMeshOBJFile(&asset->mesh, request->objFileName, false)) {
+        fprintf(stderr, "Error loading the asset %s.\n", request->objFileName);
+        free(asset);
+        PROFILE_END();
+        return;
+    }
+    if (request->pngFileName[0] != '\0') {
+        decodePNGTexture(request->pngFileName, &asset->texture);
+    }
+
+    LoadedAsset *replaced = SDL_AtomicSetPtr(&readyAsset, asset);
+    if (replaced) {
+        freeLoadedAsset(replaced);
+    }
+    PROFILE_END();
+}
+
+static int assetLoader(void *data) {
+    (void) data;
+    PROFILE_THREAD_NAME("asset loader");
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    for (;;) {
+        SDL_LockMutex(loaderMutex);
+        while (numRequests == 0 && !isLoaderStopping) {
+            SDL_CondWait(loaderCondition, loaderMutex);
+        }
+        if (isLoaderStopping) {
+            SDL_UnlockMutex(loaderMutex);
+            return 0;
+        }
+        const AssetRequest request = requests[firstRequest];
+        firstRequest = (firstRequest + 1) % ASSET_LOAD_QUEUE_SIZE;
+        numRequests--;
+        isLoading = true;
+        SDL_UnlockMutex(loaderMutex);
+
+        loadAsset(&request);
+
+        SDL_LockMutex(loaderMutex);
+        isLoading = false;
+        SDL_CondBroadcast(loaderCondition);
+        SDL_UnlockMutex(loaderMutex);
+    }
+}
+
+// without the thread requestAssetLoad loads right away, the frames stall but still work
+bool startAssetLoader(void) {
+    isLoaderStopping = false;
+    loaderMutex = SDL_CreateMutex();
+    loaderCondition = SDL_CreateCond();
+    if (loaderMutex && loaderCondition) {
+        loaderThread = SDL_CreateThread(assetLoader, "assetLoader", NULL);
+    }
+    if (!loaderThread) {
+        fprintf(stderr, "Error creating the asset loader thread, assets will load on the main thread.\n");
+        return false;
+    }
+    return true;
+}
+
+void stopAssetLoader(void) {
+    if (loaderThread) {
+        SDL_LockMutex(loaderMutex);
+        isLoaderStopping = true;
+        SDL_CondBroadcast(loaderCondition);
+        SDL_UnlockMutex(loaderMutex);
+        SDL_WaitThread(loaderThread, NULL);
+        loaderThread = NULL;
+    }
+    SDL_DestroyCond(loaderCondition);
+    SDL_DestroyMutex(loaderMutex);
+    loaderCondition = NULL;
+    loaderMutex = NULL;
+    numRequests = 0;
+
+    LoadedAsset *asset = SDL_AtomicSetPtr(&readyAsset, NULL);
+    if (asset) {
+        freeLoadedAsset(asset);
+    }
+    freeTextureImage(&pendingTexture);
+    hasPendingTexture = false;
+}
+
+bool requestAssetLoad(const char *objFileName, const char *pngFileName) {
+    AssetRequest request;
+    if (snprintf(request.objFileName, ASSET_PATH_SIZE, "%s", objFileName) >= ASSET_PATH_SIZE ||
+        snprintf(request.pngFileName, ASSET_PATH_SIZE, "%s", pngFileName ? pngFileName : "") >= ASSET_PATH_SIZE) {
+        fprintf(stderr, "Asset path too long: %s\n", objFileName);
+        return false;
+    }
+    if (!loaderThread) {
+        loadAsset(&request);
+        return true;
+    }
+
+    SDL_LockMutex(loaderMutex);
+    const bool hasRoom = numRequests < ASSET_LOAD_QUEUE_SIZE;
+    if (hasRoom) {
+        requests[(firstRequest + numRequests) % ASSET_LOAD_QUEUE_SIZE] = request;
+        numRequests++;
+        SDL_CondBroadcast(loaderCondition);
+    }
+    SDL_UnlockMutex(loaderMutex);
+    if (!hasRoom) {
+        fprintf(stderr, "Too many assets loading, skipping %s.\n", objFileName);
+    }
+    return hasRoom;
+}
+
+void applyLoadedAssets(void) {
+    if (hasPendingTexture) {
+        setMeshTexture(&pendingTexture);
+        pendingTexture.pixels = NULL;
+        hasPendingTexture = false;
+    }
+
+    LoadedAsset *asset = SDL_AtomicSetPtr(&readyAsset, NULL);
+    if (!asset) {
+        return;
+    }
+    // the new mesh takes the place of the old one in the scene
+    asset->mesh.rotation = mesh.rotation;
+    asset->mesh.scale = mesh.scale;
+    asset->mesh.translation = mesh.translation;
+    freeMesh();
+    mesh = asset->mesh;
+    pendingTexture = asset->texture;
+    hasPendingTexture = true;
+    free(asset);
+}
+
+void finishAssetLoads(void) {
+    if (loaderThread) {
+        SDL_LockMutex(loaderMutex);
+        while (numRequests > 0 || isLoading) {
+            SDL_CondWait(loaderCondition, loaderMutex);
+        }
+        SDL_UnlockMutex(loaderMutex);
+    }
+    applyLoadedAssets();
+    // no frame is in flight, the texture does not have to wait for one
+    applyLoadedAssets();
+}
@@ -0,0 +1,21 @@
+#ifndef SDL2_SOFTWARE_RENDERER_LOADER_H
+#define SDL2_SOFTWARE_RENDERER_LOADER_H
+
+#include <stdbool.h>
+
+bool startAssetLoader(void);
+void stopAssetLoader(void);
+
+// queue an OBJ file and its PNG texture (NULL for none) to be loaded on the
+// loader thread, returns false if the queue is full
+bool requestAssetLoad(const char *objFileName, const char *pngFileName);
+
+// make the assets that finished loading the ones rendered, to be called
+// between frames while no geometry or rasterization is running
+void applyLoadedAssets(void);
+
+// block until every queued asset is loaded and apply it, for headless runs
+// that have to render the same frames every time
+void finishAssetLoads(void);
+
+#endif //SDL2_SOFTWARE_RENDERER_LOADER_H
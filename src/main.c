@@ -1,29 +1,40 @@
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 
-#include "upng.h"
-#include "array.h"
 #include "display.h"
-#include "light.h"
-#include "matrix.h"
 #include "mesh.h"
 #include "vector.h"
 #include "texture.h"
 #include "camera.h"
 #include "clipping.h"
+#include "job.h"
+#include "loader.h"
+#include "profile.h"
+#include "renderer.h"
 
-#define MAX_TRIANGLES 10000
-Triangle trianglesToRender[MAX_TRIANGLES];
-int numTrianglesToRender = 0;
 float deltaTime = 0.0f;
 
-Mat4 projectionMatrix;
-
 Uint32 previousFrameTime = 0;
 
 bool isRunning = false;
 bool isPaused = false;
 
+// threads to render with, 0 for one per core
+int numRenderThreads = 0;
+
+// the assets 'n' goes through, the first one is loaded at startup
+static const char *assetNames[] = {"f22", "f117", "efa", "crab", "drone", "cube"};
+#define NUM_ASSETS (int) (sizeof(assetNames) / sizeof(assetNames[0]))
+int currentAsset = 0;
+
+void requestAsset(int asset) {
+    char objFileName[256];
+    char pngFileName[256];
+    snprintf(objFileName, sizeof(objFileName), "../assets/%s.obj", assetNames[asset]);
+    snprintf(pngFileName, sizeof(pngFileName), "../assets/%s.png", assetNames[asset]);
+    requestAssetLoad(objFileName, pngFileName);
+}
+
 void setup(void) {
     // Allocate the required memory in bytes to hold the color buffer
     setRenderMethod(RENDER_TEXTURED);
@@ -32,20 +43,13 @@ void setup(void) {
     // capture the mouse
     // SDL_SetRelativeMouseMode(SDL_TRUE);
 
-    // init perspective projection matrix
-    const float aspectX = (float) getWindowWidth() / (float) getWindowHeight();
-    const float aspectY = (float) getWindowHeight() / (float) getWindowWidth();
-    const float fovY = M_PI / 3.0f;  // the same as 180/3, or 60 degrees
-    const float fovX = 2.0f * atanf(tanf(fovY / 2.0f) * aspectX);
-    const float zNear = 1.f;
-    const float zFar = 20.0f;
-    projectionMatrix = mat4_makePerspective(fovY, aspectY, zNear, zFar);
+    initRenderer(numRenderThreads);
 
-    // init the frustum planes
-    initFrustumPlanes(fovX, fovY, zNear, zFar);
-
-    loadOBJFileData("../assets/f22.obj");
-    loadPNGTextureData("../assets/f22.png");
+    // drawn until the first asset is loaded
+    loadCubeMeshData();
+    setMeshTexture(NULL);
+    startAssetLoader();
+    requestAsset(currentAsset);
 }
 
 void processInput(void) {
@@ -97,6 +101,15 @@ void processInput(void) {
                     setRenderMethod(RENDER_TEXTURED_WIRE);
                     return;
                 }
+                if (event.key.keysym.sym == SDLK_7) {
+                    setRenderMethod(RENDER_OVERDRAW);
+                    return;
+                }
+                if (event.key.keysym.sym == SDLK_n) {
+                    currentAsset = (currentAsset + 1) % NUM_ASSETS;
+                    requestAsset(currentAsset);
+                    return;
+                }
                 if (event.key.keysym.sym == SDLK_c) {
                     setCullMethod(CULL_BACKFACE);
                     return;
@@ -105,6 +118,19 @@ void processInput(void) {
                     setCullMethod(CULL_NONE);
                     return;
                 }
+                if (event.key.keysym.sym == SDLK_p) {
+                    printPipelineStats(stdout, "Last frame", getFrameStats());
+                    printPipelineStats(stdout, "Since start", getTotalStats());
+                    return;
+                }
+                if (event.key.keysym.sym == SDLK_g) {
+                    setClipMethod(CLIP_GUARD_BAND);
+                    return;
+                }
+                if (event.key.keysym.sym == SDLK_f) {
+                    setClipMethod(CLIP_FRUSTUM);
+                    return;
+                }
                 if (event.key.keysym.sym == SDLK_SPACE) {
                     isPaused = !isPaused;
                     return;
@@ -151,23 +177,28 @@ void processInput(void) {
     }
 }
 
-void update(void) {
-    const int timeToWait = FRAME_TARGET_TIME - (SDL_GetTicks() - previousFrameTime);
-    if (timeToWait > 0 && timeToWait <= FRAME_TARGET_TIME) {
-        SDL_Delay(timeToWait);
+void waitForNextFrame(void) {
+    if (isHeadlessDisplay()) {
+        // nobody is watching, render as fast as possible with a fixed time step
+        // so the frames are the same on every run
+        deltaTime = FRAME_TARGET_TIME / 1000.0f;
+    } else {
+        const int timeToWait = FRAME_TARGET_TIME - (SDL_GetTicks() - previousFrameTime);
+        if (timeToWait > 0 && timeToWait <= FRAME_TARGET_TIME) {
+            SDL_Delay(timeToWait);
+        }
+        // get the delta time in seconds
+        deltaTime = (SDL_GetTicks() - previousFrameTime) / 1000.0f;
     }
-    // get the delta time in seconds
-    deltaTime = (SDL_GetTicks() - previousFrameTime) / 1000.0f;
 
     // calculate the fps
 //    const float fps = 1.0f / deltaTime;
 //    printf("FPS: %f\n", fps);
 
     previousFrameTime = SDL_GetTicks();
+}
 
-    // reset the number of triangles to render for the current frame
-    numTrianglesToRender = 0;
-
+void update(void) {
     if (!isPaused) {
         const float rotation = 0.5f;
 //        mesh.rotation.x += rotation * deltaTime;
@@ -181,216 +212,226 @@ void update(void) {
         mesh.translation.z = 5.0f;
     }
 
-    // create the view matrix
-    Vec3 upDuration = {0, 1, 0};
-    Vec3 target = getCameraLookAtTarget();
-    Mat4 viewMatrix = mat4_lookAt(getCameraPosition(), target, upDuration);
-
-    for (int i = 0; i < array_length(mesh.faces); i++) {
-        const Face meshFace = mesh.faces[i];
-        const Vec3 faceVertices[] = {
-            mesh.vertices[meshFace.a],
-            mesh.vertices[meshFace.b],
-            mesh.vertices[meshFace.c],
-        };
-
-        Vec4 transformedVertices[3];
-        for (int j = 0; j < 3; j++) {
-            Vec4 transformedVertex = vec4_fromVec3(faceVertices[j]);
-            Mat4 worldMatrix = mat4_makeWorld(mesh.translation, mesh.rotation, mesh.scale);
-            transformedVertex = mat4_mulVec4(worldMatrix, transformedVertex);
-
-            // transform the vertex using the view matrix
-            transformedVertex = mat4_mulVec4(viewMatrix, transformedVertex);
-
-            transformedVertices[j] = transformedVertex;
-        }
-
-        // triangle culling
-        /*   A
-         *  /  \
-         * B----C */
-        const Vec3 vectorA = vec3_fromVec4(transformedVertices[0]);
-        const Vec3 vectorB = vec3_fromVec4(transformedVertices[1]);
-        const Vec3 vectorC = vec3_fromVec4(transformedVertices[2]);
-        Vec3 vectorAB = vec3_sub(vectorB, vectorA);
-        Vec3 vectorAC = vec3_sub(vectorC, vectorA);
-        vec3_normalize(&vectorAB);
-        vec3_normalize(&vectorAC);
-
-        // compute face normal using the cross product to find the perpendicular.
-        // the order matters, we are using a left-handed coordinate system (Z
-        // grows inside the screen).
-        Vec3 normal = vec3_cross(vectorAB, vectorAC);
-
-        // normalize the normal
-        vec3_normalize(&normal);
-
-        Vec3 origin = {0, 0, 0};
-        // find the vector between a point in the triangle and the camera origin
-        const Vec3 cameraRay = vec3_sub(origin, vectorA);
-
-        if (getCullMethod() == CULL_BACKFACE) {
-            // check if this triangle is aligned with the screen
-            // bypass the triangles that are looking away from the camera
-            if (vec3_dot(normal, cameraRay) < 0) {
-                continue;;
-            }
-        }
+    processGeometry();
+}
 
-        // Clipping
-        // clip the triangle against the near plane
-        Polygon polygon = createPolygonFromTriangle(
-            vec3_fromVec4(transformedVertices[0]),
-            vec3_fromVec4(transformedVertices[1]),
-            vec3_fromVec4(transformedVertices[2]),
-            meshFace.vertexA_UV,
-            meshFace.vertexB_UV,
-            meshFace.vertexC_UV
-        );
+void render(void) {
+    rasterizeFrame();
 
-        clipPolygon(&polygon);
+    PROFILE_BEGIN("present");
+    renderColorBuffer();
+    PROFILE_END();
+}
 
-        // break the polygon into triangles
-        Triangle trianglesAfterClipping[MAX_NUM_POLY_TRIANGLES];
-        int numTrianglesAfterClipping = 0;
+///////////////////////////////////////////////////////////////////////////////
+// Pipelined frames
+///////////////////////////////////////////////////////////////////////////////
+// update() of the next frame runs on the geometry thread while the main
+// thread rasterizes and presents the current one. Each side has its own
+// render queue, and they trade them with swapRenderQueues once both are done:
+//
+//   main thread      | input | render N   | swap | input | render N+1 | swap |
+//   geometry thread  |       | update N+1 |      |       | update N+2 |      |
+//
+// Input is read before the geometry of the next frame starts, so the screen
+// is at most one frame behind it. The two threads never write the same data
+// at the same time: the camera and mesh are only changed by the input and
+// update(), the color and z buffers only by render().
+///////////////////////////////////////////////////////////////////////////////
+static SDL_Thread *geometryThread = NULL;
+static SDL_sem *geometryStart = NULL;
+static SDL_sem *geometryDone = NULL;
+static bool isGeometryStopping = false;
+
+static int geometryWorker(void *data) {
+    (void) data;
+    PROFILE_THREAD_NAME("geometry");
+    for (;;) {
+        SDL_SemWait(geometryStart);
+        if (isGeometryStopping) {
+            return 0;
+        }
+        PROFILE_BEGIN("update");
+        update();
+        PROFILE_END();
+        SDL_SemPost(geometryDone);
+    }
+}
 
-        // trianglesAfterClipping gets passed by reference here in C
-        createTrianglesFromPolygon(&polygon, trianglesAfterClipping, &numTrianglesAfterClipping);
+// without the thread the frames still work, update() just runs on the main thread
+void startGeometryThread(void) {
+    if (getJobThreadCount() == 1) {
+        // asked to render on a single thread
+        return;
+    }
+    geometryStart = SDL_CreateSemaphore(0);
+    geometryDone = SDL_CreateSemaphore(0);
+    if (geometryStart && geometryDone) {
+        geometryThread = SDL_CreateThread(geometryWorker, "geometry", NULL);
+    }
+    if (!geometryThread) {
+        fprintf(stderr, "Error creating the geometry thread, frames will not be pipelined.\n");
+    }
+}
 
-        // loop all the triangles after clipping
-        for (int t = 0; t < numTrianglesAfterClipping; t++) {
-            Triangle clippedTriangle = trianglesAfterClipping[t];
+void stopGeometryThread(void) {
+    if (geometryThread) {
+        isGeometryStopping = true;
+        SDL_SemPost(geometryStart);
+        SDL_WaitThread(geometryThread, NULL);
+        geometryThread = NULL;
+    }
+    if (geometryStart) {
+        SDL_DestroySemaphore(geometryStart);
+        geometryStart = NULL;
+    }
+    if (geometryDone) {
+        SDL_DestroySemaphore(geometryDone);
+        geometryDone = NULL;
+    }
+}
 
-            // loop all three vertices to perform projection
-            Vec4 projectedPoints[3];
-            for (int j = 0; j < 3; j++) {
-                projectedPoints[j] = mat4_mulVec4Project(projectionMatrix, clippedTriangle.points[j]);
+void beginNextFrameUpdate(void) {
+    if (geometryThread) {
+        SDL_SemPost(geometryStart);
+    } else {
+        PROFILE_BEGIN("update");
+        update();
+        PROFILE_END();
+    }
+}
 
+void finishNextFrameUpdate(void) {
+    if (geometryThread) {
+        PROFILE_BEGIN("wait for geometry");
+        SDL_SemWait(geometryDone);
+        PROFILE_END();
+    }
+    swapRenderQueues();
+    // neither the geometry nor the rasterizer is running, meshes can be swapped
+    applyLoadedAssets();
+}
 
-                // in screen space, invert Y values to account for flipped screen coordinates
-                projectedPoints[j].y *= -1;
+void freeResources(void) {
+    destroyRenderer();
+    freeMesh();
+    // back to the placeholder, which frees the texture
+    setMeshTexture(NULL);
+}
 
-                // Scale into the viewport (has to go first)
-                projectedPoints[j].x *= (float) getWindowWidth() / 2.0f;
-                projectedPoints[j].y *= (float) getWindowHeight() / 2.0f;
+static void printUsage(const char *program) {
+    fprintf(
+        stderr,
+        "usage: %s [--headless] [--size WIDTHxHEIGHT] [--frames N] [--output PATTERN]\n"
+        "          [--threads N] [--trace PATH] [--stats]\n"
+        "  --headless        render offscreen, without a window\n"
+        "  --size WxH        size of the headless frames (default 800x600)\n"
+        "  --frames N        number of headless frames to render (default 1)\n"
+        "  --output PATTERN  save every headless frame as a PPM, PATTERN is a printf\n"
+        "                    format for the frame number, e.g. frame_%%04d.ppm\n"
+        "  --threads N       threads to render with, 1 runs everything on the main\n"
+        "                    thread and 0 starts one per core (default 0)\n"
+        "  --trace PATH      write the timings of every pipeline stage as a Chrome\n"
+        "                    trace_event file, needs a build with ENABLE_PROFILING\n"
+        "  --stats           print the pipeline statistics of the run at exit\n",
+        program
+    );
+}
 
-                // translate the projected points to the middle of the screen
-                projectedPoints[j].x += (float) getWindowWidth() / 2.0f;
-                projectedPoints[j].y += (float) getWindowHeight() / 2.0f;
+int main(int argc, char *argv[]) {
+    bool headless = false;
+    int headlessWidth = 800;
+    int headlessHeight = 600;
+    int numHeadlessFrames = 1;
+    const char *outputPattern = NULL;
+    const char *tracePath = NULL;
+    bool printStats = false;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--size") == 0 && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &headlessWidth, &headlessHeight) != 2) {
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
             }
+        } else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            numHeadlessFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+            outputPattern = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && hasValue) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            numRenderThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            printStats = true;
+        } else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
+    isRunning = headless ? initializeHeadless(headlessWidth, headlessHeight) : initializeWindow();
 
-            // Calculate the shade of the triangle based on the direction of the light
-            // and the normal of the face.
-            // we need the inverse of the normal to calculate the light intensity because
-            // our Z grows towards the screen, not from the screen.
-            float lightIntensityFactor = -1 * vec3_dot(normal, light.direction);
-
-            uint32_t triangleColor = lightApplyIntensity(meshFace.color, lightIntensityFactor);
-
-            Triangle triangleToRender = {
-                .points = {
-                    {projectedPoints[0].x, projectedPoints[0].y, projectedPoints[0].z, projectedPoints[0].w},
-                    {projectedPoints[1].x, projectedPoints[1].y, projectedPoints[1].z, projectedPoints[1].w},
-                    {projectedPoints[2].x, projectedPoints[2].y, projectedPoints[2].z, projectedPoints[2].w},
-                },
-                .textCoords = {
-                    {clippedTriangle.textCoords[0].u, clippedTriangle.textCoords[0].v},
-                    {clippedTriangle.textCoords[1].u, clippedTriangle.textCoords[1].v},
-                    {clippedTriangle.textCoords[2].u, clippedTriangle.textCoords[2].v},
-                },
-                .color = triangleColor,
-            };
-            if (numTrianglesToRender < MAX_TRIANGLES) {
-                trianglesToRender[numTrianglesToRender] = triangleToRender;
-                numTrianglesToRender++;
-            }
-        }
+    setup();
+    if (headless) {
+        // the frames must not depend on how fast the assets load
+        finishAssetLoads();
     }
-}
 
-void render(void) {
-    clearColorBuffer(0xFF000000);
-    clearZBuffer();
-    drawGrid();
-
-    // Loop all projected triangles and render them
-    // render the projected triangles
-    for (int i = 0; i < numTrianglesToRender; i++) {
-        const Triangle triangle = trianglesToRender[i];
-
-        if (shouldRenderFilledTriangle()) {
-            drawFilledTriangle(
-                triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w, // vertex A
-                triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w, // vertex B
-                triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w, // vertex C
-                triangle.color
-            );
+    if (tracePath) {
+        if (!isProfilingAvailable()) {
+            fprintf(stderr, "--trace needs a build with ENABLE_PROFILING.\n");
+            return EXIT_FAILURE;
         }
+        PROFILE_THREAD_NAME("main");
+        startProfiling();
+    }
 
-        if (shouldRenderTexturedTriangle()) {
-            drawTexturedTriangle(
-                triangle.points[0].x, triangle.points[0].y, triangle.points[0].z, triangle.points[0].w,
-                triangle.textCoords[0].u, triangle.textCoords[0].v, // vertex A
-                triangle.points[1].x, triangle.points[1].y, triangle.points[1].z, triangle.points[1].w,
-                triangle.textCoords[1].u, triangle.textCoords[1].v, // vertex B
-                triangle.points[2].x, triangle.points[2].y, triangle.points[2].z, triangle.points[2].w,
-                triangle.textCoords[2].u, triangle.textCoords[2].v, // vertex C
-                meshTexture
-            );
-        }
+    // the geometry of the first frame, the loop always renders the frame
+    // before the one it updates
+    waitForNextFrame();
+    update();
+    swapRenderQueues();
+    startGeometryThread();
 
-        if (shouldRenderWireframe()) {
-            Vec2 a = vec2_fromVec4(triangle.points[0]);
-            Vec2 b = vec2_fromVec4(triangle.points[1]);
-            Vec2 c = vec2_fromVec4(triangle.points[2]);
-            drawTriangle(a, b, c, 0xFFFFFFF);
+    int frame = 0;
+    while (isRunning) {
+        PROFILE_BEGIN("frame");
+        waitForNextFrame();
+        if (!headless) {
+            PROFILE_BEGIN("input");
+            processInput();
+            PROFILE_END();
         }
-
-        if (shouldRenderWireVertex()) {
-            const uint32_t dotColor = 0xFFFF0000;
-            drawRect(
-                (int) triangle.points[0].x - 3,
-                (int) triangle.points[0].y - 3,
-                6,
-                6,
-                dotColor
-            );
-            drawRect(
-                (int) triangle.points[1].x - 3,
-                (int) triangle.points[1].y - 3,
-                6,
-                6,
-                dotColor
-            );
-            drawRect(
-                (int) triangle.points[2].x - 3,
-                (int) triangle.points[2].y - 3,
-                6,
-                6,
-                dotColor
-            );
+        beginNextFrameUpdate();
+        render();
+        finishNextFrameUpdate();
+        PROFILE_END();
+
+        if (headless) {
+            if (outputPattern) {
+                char path[4096];
+                snprintf(path, sizeof(path), outputPattern, frame);
+                if (!saveColorBufferPPM(path)) {
+                    isRunning = false;
+                }
+            }
+            frame++;
+            if (frame >= numHeadlessFrames) {
+                isRunning = false;
+            }
         }
     }
 
-    renderColorBuffer();
-}
-
-void freeResources(void) {
-    freeMesh();
-    upng_free(pngTexture);
-}
-
-int main(void) {
-    isRunning = initializeWindow();
-
-    setup();
+    stopGeometryThread();
+    stopAssetLoader();
 
-    while (isRunning) {
-        processInput();
-        update();
-        render();
+    if (tracePath) {
+        writeProfileTrace(tracePath);
+    }
+    if (printStats) {
+        printPipelineStats(stdout, "Pipeline statistics", getTotalStats());
     }
 
     destroyWindow();
@@ -3,8 +3,10 @@
 //
 
 #include <math.h>
+#include <SDL2/SDL.h>
 #include "matrix.h"
 #include "vector.h"
+#include "simd.h"
 
 Mat4 mat4_identity(void) {
     // | 1 0 0 0 |
@@ -56,6 +58,92 @@ Vec4 mat4_mulVec4(Mat4 m, Vec4 v) {
     return result;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Transform count points (w = 1) stored as separate x, y and z arrays, and
+// write them out as Vec4. The SSE and AVX paths transform 4 and 8 points at
+// a time: every lane holds a different point, so each row of the matrix is
+// just a broadcast multiply-add over the x, y and z arrays.
+///////////////////////////////////////////////////////////////////////////////
+static void mat4_mulVec4BatchScalar(const Mat4 *m, const float *xs, const float *ys, const float *zs, Vec4 *out, int count) {
+    for (int i = 0; i < count; i++) {
+        Vec4 v = {xs[i], ys[i], zs[i], 1.0f};
+        out[i] = mat4_mulVec4(*m, v);
+    }
+}
+
+#if SIMD_X86
+SIMD_TARGET("sse")
+static int mat4_mulVec4BatchSSE(const Mat4 *m, const float *xs, const float *ys, const float *zs, Vec4 *out, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 x = _mm_loadu_ps(xs + i);
+        const __m128 y = _mm_loadu_ps(ys + i);
+        const __m128 z = _mm_loadu_ps(zs + i);
+        __m128 rows[4];
+        for (int row = 0; row < 4; row++) {
+            rows[row] = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m->m[row][0]), x), _mm_mul_ps(_mm_set1_ps(m->m[row][1]), y)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m->m[row][2]), z), _mm_set1_ps(m->m[row][3]))
+            );
+        }
+        // the rows hold x, y, z and w of 4 points, turn them into 4 Vec4
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+        _mm_storeu_ps(&out[i + 0].x, rows[0]);
+        _mm_storeu_ps(&out[i + 1].x, rows[1]);
+        _mm_storeu_ps(&out[i + 2].x, rows[2]);
+        _mm_storeu_ps(&out[i + 3].x, rows[3]);
+    }
+    return i;
+}
+
+SIMD_TARGET("avx")
+static int mat4_mulVec4BatchAVX(const Mat4 *m, const float *xs, const float *ys, const float *zs, Vec4 *out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(xs + i);
+        const __m256 y = _mm256_loadu_ps(ys + i);
+        const __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 rows[4];
+        for (int row = 0; row < 4; row++) {
+            rows[row] = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m->m[row][0]), x), _mm256_mul_ps(_mm256_set1_ps(m->m[row][1]), y)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m->m[row][2]), z), _mm256_set1_ps(m->m[row][3]))
+            );
+        }
+
+        // transpose in each 128-bit half: point 0 | point 4, point 1 | point 5, ...
+        const __m256 xy01 = _mm256_unpacklo_ps(rows[0], rows[1]);
+        const __m256 xy23 = _mm256_unpackhi_ps(rows[0], rows[1]);
+        const __m256 zw01 = _mm256_unpacklo_ps(rows[2], rows[3]);
+        const __m256 zw23 = _mm256_unpackhi_ps(rows[2], rows[3]);
+        const __m256 point04 = _mm256_shuffle_ps(xy01, zw01, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 point15 = _mm256_shuffle_ps(xy01, zw01, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 point26 = _mm256_shuffle_ps(xy23, zw23, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 point37 = _mm256_shuffle_ps(xy23, zw23, _MM_SHUFFLE(3, 2, 3, 2));
+
+        // then swap the halves around to store 8 consecutive Vec4
+        _mm256_storeu_ps(&out[i + 0].x, _mm256_permute2f128_ps(point04, point15, 0x20));
+        _mm256_storeu_ps(&out[i + 2].x, _mm256_permute2f128_ps(point26, point37, 0x20));
+        _mm256_storeu_ps(&out[i + 4].x, _mm256_permute2f128_ps(point04, point15, 0x31));
+        _mm256_storeu_ps(&out[i + 6].x, _mm256_permute2f128_ps(point26, point37, 0x31));
+    }
+    return i;
+}
+#endif
+
+void mat4_mulVec4Batch(const Mat4 *m, const float *xs, const float *ys, const float *zs, Vec4 *out, int count) {
+    int done = 0;
+#if SIMD_X86
+    if (SDL_HasAVX()) {
+        done = mat4_mulVec4BatchAVX(m, xs, ys, zs, out, count);
+    } else if (SDL_HasSSE()) {
+        done = mat4_mulVec4BatchSSE(m, xs, ys, zs, out, count);
+    }
+#endif
+    // whatever does not fill a whole vector
+    mat4_mulVec4BatchScalar(m, xs + done, ys + done, zs + done, out + done, count - done);
+}
+
 Mat4 mat4_makeRotationX(float angle) {
     float c = cosf(angle);
     float s = sinf(angle);
@@ -20,6 +20,7 @@ Mat4 mat4_makeRotationZ(float rz);
 Mat4 mat4_makeWorld(Vec3 position, Vec3 rotation, Vec3 scale);
 Mat4 mat4_makePerspective(float fov, float aspect, float znear, float zfar);
 Vec4 mat4_mulVec4(Mat4 m, Vec4 v);
+void mat4_mulVec4Batch(const Mat4 *m, const float *xs, const float *ys, const float *zs, Vec4 *out, int count);
 Mat4 mat4_mulMat4(Mat4 m1, Mat4 m2);
 Vec4 mat4_mulVec4Project(Mat4 m, Vec4 v);
 Mat4 mat4_lookAt(Vec3 eye, Vec3 target, Vec3 up);
@@ -1,11 +1,17 @@
 #include "mesh.h"
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <SDL2/SDL.h>
 
 #include "array.h"
+#include "job.h"
+#include "simd.h"
 #include "vector.h"
 
 Vec3 cubeVertices[N_CUBE_VERTICES] = {
@@ -42,13 +48,35 @@ Face cubeFaces[N_CUBE_FACES] = {
 
 Mesh mesh = {
     .vertices = NULL,
+    .vertexArrays = {.x = NULL, .y = NULL, .z = NULL, .numVertices = 0},
     .faces = NULL,
+    .cache = {.data = NULL, .size = 0},
     .rotation = {.x = 0, .y = 0, .z = 0},
     .scale = {.x = 1.0f, .y = 1.0f, .z = 1.0f},
     .translation = {.x = 0, .y = 0, .z = 0},
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// The arrays of a cached mesh are read-only, copy them to the heap before
+// anything is added to them
+///////////////////////////////////////////////////////////////////////////////
+static void copyMeshFromCache(Mesh *target) {
+    if (!target->cache.data) {
+        return;
+    }
+    const int numVertices = array_length(target->vertices);
+    const int numFaces = array_length(target->faces);
+    Vec3 *vertices = array_hold(NULL, numVertices, sizeof(Vec3));
+    Face *faces = array_hold(NULL, numFaces, sizeof(Face));
+    memcpy(vertices, target->vertices, sizeof(Vec3) * numVertices);
+    memcpy(faces, target->faces, sizeof(Face) * numFaces);
+    unmapMeshCache(&target->cache);
+    target->vertices = vertices;
+    target->faces = faces;
+}
+
 void loadCubeMeshData(void) {
+    copyMeshFromCache(&mesh);
     for (int i = 0; i < N_CUBE_VERTICES; i++) {
         array_push(mesh.vertices, cubeVertices[i]);
     }
@@ -61,56 +89,547 @@ void loadCubeMeshData(void) {
     mesh.rotation.z = 0;
 }
 
-void loadOBJFileData(const char *fileName) {
-    FILE *file = fopen(fileName, "r");
+static void freeVertexArrays(Mesh *target) {
+    SDL_SIMDFree(target->vertexArrays.x);
+    SDL_SIMDFree(target->vertexArrays.y);
+    SDL_SIMDFree(target->vertexArrays.z);
+    target->vertexArrays.x = NULL;
+    target->vertexArrays.y = NULL;
+    target->vertexArrays.z = NULL;
+    target->vertexArrays.numVertices = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Copy the vertices of big meshes into separate x, y and z arrays. Small
+// meshes keep using only the Vec3 array, the batch would not pay off.
+///////////////////////////////////////////////////////////////////////////////
+static void buildVertexArrays(Mesh *target) {
+    freeVertexArrays(target);
+
+    const int numVertices = array_length(target->vertices);
+    if (numVertices < MESH_VERTEX_ARRAYS_MIN_VERTICES) {
+        return;
+    }
+
+    // SDL_SIMDAlloc aligns to the widest vector the CPU supports (at least
+    // 32 bytes with AVX)
+    target->vertexArrays.x = SDL_SIMDAlloc(sizeof(float) * numVertices);
+    target->vertexArrays.y = SDL_SIMDAlloc(sizeof(float) * numVertices);
+    target->vertexArrays.z = SDL_SIMDAlloc(sizeof(float) * numVertices);
+    if (!target->vertexArrays.x || !target->vertexArrays.y || !target->vertexArrays.z) {
+        fprintf(stderr, "Error allocating the vertex arrays, using the Vec3 vertices.\n");
+        freeVertexArrays(target);
+        return;
+    }
+    for (int i = 0; i < numVertices; i++) {
+        target->vertexArrays.x[i] = target->vertices[i].x;
+        target->vertexArrays.y[i] = target->vertices[i].y;
+        target->vertexArrays.z[i] = target->vertices[i].z;
+    }
+    target->vertexArrays.numVertices = numVertices;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// OBJ loading
+///////////////////////////////////////////////////////////////////////////////
+// The whole file is read with a single fread and parsed in place. It is
+// split into chunks of whole lines that are loaded in parallel on the job
+// system, in three steps with a batch of jobs each:
+//
+//   1. count     every chunk counts its vertices, texture coordinates and
+//                faces by looking only at the start of every line. The sums
+//                of the chunks before give where every chunk starts writing
+//                in the file-wide arrays, which are allocated once.
+//   2. parse     every chunk reads its numbers with the scanners below
+//                instead of sscanf, which interprets its format string and
+//                goes through the locale on every call. Vertices and texture
+//                coordinates go straight to their place in the file-wide
+//                arrays, faces become triangles of indices in an array of
+//                the chunk, since a polygon makes more than one.
+//   3. stitch    once every texture coordinate is known the triangles are
+//                turned into faces, copied to their place in mesh.faces.
+//
+// Indices are resolved while parsing, a chunk knows how many vertices and
+// texture coordinates come before it from the counts. With a single thread
+// the steps just run one chunk after the other.
+//
+// Faces can be written as v, v/vt, v//vn or v/vt/vn, and negative indices
+// count back from the last vertex read so far. Polygons with more than 3
+// vertices are split into a fan of triangles.
+///////////////////////////////////////////////////////////////////////////////
+#define OBJ_CHUNK_SIZE (256 * 1024)
+
+typedef struct {
+    int vertex;
+    int texCoord;  // -1 when the face has no texture coordinates
+} FaceCorner;
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static const char *skipBlanks(const char *p) {
+    while (isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// the start of the line after p, the scanners usually leave p right at its end
+static const char *nextLine(const char *p) {
+    if (*p == '\n') {
+        return p + 1;
+    }
+    const char *end = strchr(p, '\n');
+    return end ? end + 1 : p + strlen(p);
+}
+
+// fileStat is taken from the open file before it is read, for the mesh cache
+static char *readWholeFile(const char *fileName, size_t *fileSize, struct stat *fileStat) {
+    FILE *file = fopen(fileName, "rb");
     if (!file) {
-        fprintf(stderr, "Error opening file: %s\n", fileName);
-        exit(1);
+        return NULL;
     }
+    char *data = NULL;
+    if (fstat(fileno(file), fileStat) == 0 && fseek(file, 0, SEEK_END) == 0) {
+        const long size = ftell(file);
+        rewind(file);
+        data = size >= 0 ? malloc(size + 1) : NULL;
+        if (data && fread(data, 1, size, file) == (size_t) size) {
+            data[size] = '\0';
+            *fileSize = size;
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+// 10^exponent, exact up to 10^22
+static double powerOfTen(int exponent) {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    double result = 1;
+    for (; exponent > 22; exponent -= 22) {
+        result *= 1e22;
+    }
+    return result * powers[exponent];
+}
 
-    char line[1024];
-    Texture2 *texCoordinates = NULL;
+///////////////////////////////////////////////////////////////////////////////
+// Read a decimal number like -12.5e-3 at p and return where it ends, or p
+// itself when there is no number there. The digits are collected in an
+// integer and scaled by a power of ten once: dividing by an exact power of
+// ten rounds correctly, so the result is the same float sscanf gives for the
+// numbers OBJ exporters write.
+///////////////////////////////////////////////////////////////////////////////
+static const char *scanFloat(const char *p, float *value) {
+    const char *start = p;
+    const bool isNegative = *p == '-';
+    if (*p == '-' || *p == '+') {
+        p++;
+    }
 
-    while (fgets(line, sizeof(line), file)) {
-        if (strncmp(line, "v ", 2) == 0) {
-            Vec3 vertex;
-            sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-            array_push(mesh.vertices, vertex);
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int numDigits = 0;
+    for (; isDigit(*p); p++, numDigits++) {
+        if (mantissa < 1000000000000000000ull) {
+            mantissa = mantissa * 10 + (*p - '0');
+        } else {
+            // more digits than a double keeps, only their magnitude counts
+            exponent++;
         }
-        if (strncmp(line, "vt ", 3) == 0) {
-            Texture2 texCoord;
-            sscanf(line, "vt %f %f", &texCoord.u, &texCoord.v);
-            array_push(texCoordinates, texCoord);
+    }
+    if (*p == '.') {
+        for (p++; isDigit(*p); p++, numDigits++) {
+            if (mantissa < 1000000000000000000ull) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
         }
-        if (strncmp(line, "f ", 2) == 0) {
-            int vertexIndices[3];
-            int textureIndices[3];
-            int normalIndices[3];
-            sscanf(
-                line,
-                "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                &vertexIndices[0], &textureIndices[0], &normalIndices[0],
-                &vertexIndices[1], &textureIndices[1], &normalIndices[1],
-                &vertexIndices[2], &textureIndices[2], &normalIndices[2]
-            );
-            const Face face = {
-                .a = vertexIndices[0] - 1,
-                .b = vertexIndices[1] - 1,
-                .c = vertexIndices[2] - 1,
-                .vertexA_UV = texCoordinates[textureIndices[0] - 1],
-                .vertexB_UV = texCoordinates[textureIndices[1] - 1],
-                .vertexC_UV = texCoordinates[textureIndices[2] - 1],
-                .color = 0xFFFFFFFF,
-            };
-            array_push(mesh.faces, face);
+    }
+    if (numDigits == 0) {
+        return start;
+    }
+
+    if ((*p == 'e' || *p == 'E') && (isDigit(p[1]) || ((p[1] == '-' || p[1] == '+') && isDigit(p[2])))) {
+        p++;
+        const bool isExponentNegative = *p == '-';
+        if (*p == '-' || *p == '+') {
+            p++;
+        }
+        int exponentValue = 0;
+        for (; isDigit(*p); p++) {
+            if (exponentValue < 10000) {
+                exponentValue = exponentValue * 10 + (*p - '0');
+            }
         }
+        exponent += isExponentNegative ? -exponentValue : exponentValue;
     }
 
-    array_free(texCoordinates);
-    fclose(file);
+    double result = (double) mantissa;
+    if (exponent < 0) {
+        result /= powerOfTen(-exponent);
+    } else if (exponent > 0) {
+        result *= powerOfTen(exponent);
+    }
+    *value = (float) (isNegative ? -result : result);
+    return p;
+}
+
+static const char *scanInt(const char *p, int *value) {
+    const char *start = p;
+    const bool isNegative = *p == '-';
+    if (*p == '-' || *p == '+') {
+        p++;
+    }
+    if (!isDigit(*p)) {
+        return start;
+    }
+    int result = 0;
+    for (; isDigit(*p); p++) {
+        result = result * 10 + (*p - '0');
+    }
+    *value = isNegative ? -result : result;
+    return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Counting: every line is classified by its first characters only, so all
+// it takes is finding the newlines. The SSE2 path compares 16 bytes at a
+// time and looks at the lines starting in them, the rest of the chunk, or
+// all of it without SSE2, goes through memchr. Faces are counted as one
+// triangle, polygons grow the array of the chunk.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    int vertices;
+    int texCoords;
+    int faces;
+} OBJLineCounts;
+
+static void countOBJLine(const char *line, OBJLineCounts *counts) {
+    const char *p = skipBlanks(line);
+    if (p[0] == 'v' && isBlank(p[1])) {
+        counts->vertices++;
+    } else if (p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+        counts->texCoords++;
+    } else if (p[0] == 'f' && isBlank(p[1])) {
+        counts->faces++;
+    }
+}
+
+#if SIMD_X86
+SIMD_TARGET("sse2")
+static size_t countOBJLinesSSE2(const char *data, size_t size, OBJLineCounts *counts) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *) (data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+        for (; mask != 0; mask &= mask - 1) {
+            countOBJLine(data + i + firstMaskLane(mask) + 1, counts);
+        }
+    }
+    return i;
+}
+#endif
+
+// the lines starting in the size bytes at data, a newline at the very end
+// starts a line of the next chunk
+static OBJLineCounts countOBJLines(const char *data, size_t size) {
+    OBJLineCounts counts = {0, 0, 0};
+    if (size == 0) {
+        return counts;
+    }
+    countOBJLine(data, &counts);
+
+    const size_t numNewlines = size - 1;
+    size_t done = 0;
+#if SIMD_X86
+    if (SDL_HasSSE2()) {
+        done = countOBJLinesSSE2(data, numNewlines, &counts);
+    }
+#endif
+    const char *end = data + numNewlines;
+    for (const char *p = memchr(data + done, '\n', numNewlines - done); p; p = memchr(p + 1, '\n', end - p - 1)) {
+        countOBJLine(p + 1, &counts);
+    }
+    return counts;
+}
+
+// an OBJ index, 1-based or negative from the end, as an index into the count items read so far
+static int resolveIndex(int index, int count) {
+    const int resolved = index > 0 ? index - 1 : count + index;
+    return resolved >= 0 && resolved < count ? resolved : -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Read one v, v/vt, v//vn or v/vt/vn corner of a face, returns false at the
+// end of the face
+///////////////////////////////////////////////////////////////////////////////
+static bool scanFaceCorner(const char **cursor, int numVertices, int numTexCoords, FaceCorner *corner) {
+    const char *p = skipBlanks(*cursor);
+    int vertex = 0;
+    const char *end = scanInt(p, &vertex);
+    if (end == p) {
+        return false;
+    }
+    p = end;
+
+    int texCoord = 0;
+    if (*p == '/') {
+        p = scanInt(p + 1, &texCoord);
+        if (*p == '/') {
+            int normal;
+            p = scanInt(p + 1, &normal);
+        }
+    }
+    // skip whatever else is glued to the corner
+    while (*p != '\0' && *p != '\n' && !isBlank(*p)) {
+        p++;
+    }
+    *cursor = p;
+
+    corner->vertex = resolveIndex(vertex, numVertices);
+    corner->texCoord = texCoord != 0 ? resolveIndex(texCoord, numTexCoords) : -1;
+    return true;
+}
+
+// a triangle of a face, indices into the vertices and texture coordinates of the file
+typedef struct {
+    FaceCorner corners[3];
+} OBJTriangle;
+
+typedef struct {
+    const char *start;
+    const char *end;  // right after the newline of the last line
+    OBJLineCounts counts;
+    // items of the file before the chunk
+    int firstVertex;
+    int firstTexCoord;
+    int firstTriangle;
+    OBJTriangle *triangles;
+    int numInvalidFaces;
+} OBJChunk;
+
+typedef struct {
+    bool useJobSystem;
+    OBJChunk *chunks;
+    Vec3 *vertices;  // the vertices of the file, inside mesh.vertices
+    Texture2 *texCoords;
+    Face *faces;     // the faces of the file, inside mesh.faces
+    int firstMeshVertex;
+} OBJLoad;
+
+static void runOBJJobs(OBJLoad *load, JobFunction function, int numChunks) {
+    if (load->useJobSystem) {
+        runJobs(function, load, numChunks);
+        return;
+    }
+    for (int i = 0; i < numChunks; i++) {
+        function(load, i);
+    }
+}
+
+// split the file in chunks of about OBJ_CHUNK_SIZE bytes that end after a newline
+static int splitOBJChunks(const char *data, size_t size, OBJChunk **chunks) {
+    const int numChunks = size > OBJ_CHUNK_SIZE ? (int) ((size + OBJ_CHUNK_SIZE - 1) / OBJ_CHUNK_SIZE) : 1;
+    *chunks = calloc(numChunks, sizeof(OBJChunk));
+    const char *fileEnd = data + size;
+    const char *start = data;
+    for (int i = 0; i < numChunks; i++) {
+        const char *end = fileEnd;
+        if (i < numChunks - 1) {
+            // a line longer than a chunk leaves the chunks it covers empty
+            const char *split = data + (size_t) (i + 1) * OBJ_CHUNK_SIZE;
+            if (split < start) {
+                split = start;
+            }
+            const char *newline = memchr(split, '\n', fileEnd - split);
+            end = newline ? newline + 1 : fileEnd;
+        }
+        (*chunks)[i].start = start;
+        (*chunks)[i].end = end;
+        start = end;
+    }
+    return numChunks;
+}
+
+static void countOBJChunk(void *data, int index) {
+    OBJChunk *chunk = &((OBJLoad *) data)->chunks[index];
+    chunk->counts = countOBJLines(chunk->start, chunk->end - chunk->start);
+}
+
+static void parseOBJChunk(void *data, int index) {
+    OBJLoad *load = data;
+    OBJChunk *chunk = &load->chunks[index];
+    chunk->triangles = array_reserve(NULL, chunk->counts.faces, sizeof(OBJTriangle));
+
+    // indices are resolved against what has been read up to the face
+    int numVertices = chunk->firstVertex;
+    int numTexCoords = chunk->firstTexCoord;
+    for (const char *p = chunk->start; p < chunk->end; p = nextLine(p)) {
+        p = skipBlanks(p);
+        if (p[0] == 'v' && isBlank(p[1])) {
+            Vec3 vertex = {0, 0, 0};
+            p = scanFloat(skipBlanks(p + 1), &vertex.x);
+            p = scanFloat(skipBlanks(p), &vertex.y);
+            p = scanFloat(skipBlanks(p), &vertex.z);
+            load->vertices[numVertices++] = vertex;
+        } else if (p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+            Texture2 texCoord = {0, 0};
+            p = scanFloat(skipBlanks(p + 2), &texCoord.u);
+            p = scanFloat(skipBlanks(p), &texCoord.v);
+            load->texCoords[numTexCoords++] = texCoord;
+        } else if (p[0] == 'f' && isBlank(p[1])) {
+            FaceCorner first, previous, corner;
+            int numCorners = 0;
+            p++;
+            while (scanFaceCorner(&p, numVertices, numTexCoords, &corner)) {
+                if (numCorners >= 2) {
+                    // fan triangulation: first, previous, current
+                    if (first.vertex < 0 || previous.vertex < 0 || corner.vertex < 0) {
+                        chunk->numInvalidFaces++;
+                    } else {
+                        const OBJTriangle triangle = {.corners = {first, previous, corner}};
+                        array_push(chunk->triangles, triangle);
+                    }
+                }
+                if (numCorners == 0) {
+                    first = corner;
+                }
+                previous = corner;
+                numCorners++;
+            }
+        }
+    }
+}
+
+static void stitchOBJChunk(void *data, int index) {
+    const OBJLoad *load = data;
+    OBJChunk *chunk = &load->chunks[index];
+    const int numTriangles = array_length(chunk->triangles);
+    Face *faces = load->faces + chunk->firstTriangle;
+    const Texture2 noTexCoord = {0, 0};
+    for (int i = 0; i < numTriangles; i++) {
+        const FaceCorner *corners = chunk->triangles[i].corners;
+        faces[i] = (Face) {
+            .a = load->firstMeshVertex + corners[0].vertex,
+            .b = load->firstMeshVertex + corners[1].vertex,
+            .c = load->firstMeshVertex + corners[2].vertex,
+            .vertexA_UV = corners[0].texCoord >= 0 ? load->texCoords[corners[0].texCoord] : noTexCoord,
+            .vertexB_UV = corners[1].texCoord >= 0 ? load->texCoords[corners[1].texCoord] : noTexCoord,
+            .vertexC_UV = corners[2].texCoord >= 0 ? load->texCoords[corners[2].texCoord] : noTexCoord,
+            .color = 0xFFFFFFFF,
+        };
+    }
+    array_free(chunk->triangles);
+    chunk->triangles = NULL;
+}
+
+bool loadMeshOBJFile(Mesh *target, const char *fileName, bool useJobSystem) {
+    // only a mesh loaded on its own can live in the cache file
+    const bool isMeshEmpty = array_length(target->vertices) == 0 && array_length(target->faces) == 0;
+    if (isMeshEmpty) {
+        Vec3 *vertices;
+        Face *faces;
+        MeshCacheMapping cache;
+        if (mapMeshCache(fileName, &cache, &vertices, &faces)) {
+            freeMeshData(target);
+            target->vertices = vertices;
+            target->faces = faces;
+            target->cache = cache;
+            buildVertexArrays(target);
+            return true;
+        }
+    }
+    copyMeshFromCache(target);
+
+    size_t size = 0;
+    struct stat fileStat;
+    char *data = readWholeFile(fileName, &size, &fileStat);
+    if (!data) {
+        fprintf(stderr, "Error opening file: %s\n", fileName);
+        return false;
+    }
+
+    OBJLoad load;
+    load.useJobSystem = useJobSystem;
+    const int numChunks = splitOBJChunks(data, size, &load.chunks);
+    runOBJJobs(&load, countOBJChunk, numChunks);
+
+    int numVertices = 0;
+    int numTexCoords = 0;
+    for (int i = 0; i < numChunks; i++) {
+        load.chunks[i].firstVertex = numVertices;
+        load.chunks[i].firstTexCoord = numTexCoords;
+        numVertices += load.chunks[i].counts.vertices;
+        numTexCoords += load.chunks[i].counts.texCoords;
+    }
+    load.firstMeshVertex = array_length(target->vertices);
+    target->vertices = array_hold(target->vertices, numVertices, sizeof(Vec3));
+    load.vertices = target->vertices + load.firstMeshVertex;
+    load.texCoords = array_hold(NULL, numTexCoords, sizeof(Texture2));
+    runOBJJobs(&load, parseOBJChunk, numChunks);
+
+    int numTriangles = 0;
+    int numInvalidFaces = 0;
+    for (int i = 0; i < numChunks; i++) {
+        load.chunks[i].firstTriangle = numTriangles;
+        numTriangles += array_length(load.chunks[i].triangles);
+        numInvalidFaces += load.chunks[i].numInvalidFaces;
+    }
+    const int firstFace = array_length(target->faces);
+    target->faces = array_hold(target->faces, numTriangles, sizeof(Face));
+    load.faces = target->faces + firstFace;
+    runOBJJobs(&load, stitchOBJChunk, numChunks);
+    if (numInvalidFaces > 0) {
+        fprintf(stderr, "Skipped %d triangles with invalid indices in %s\n", numInvalidFaces, fileName);
+    }
+
+    array_free(load.texCoords);
+    free(load.chunks);
+    if (isMeshEmpty) {
+        writeMeshCache(fileName, &fileStat, data, size, target->vertices, target->faces);
+    }
+    free(data);
+
+    buildVertexArrays(target);
+    return true;
+}
+
+void loadOBJFileData(const char *fileName) {
+    if (!loadMeshOBJFile(&mesh, fileName, true)) {
+        exit(1);
+    }
+}
+
+void buildMeshVertexArrays(void) {
+    buildVertexArrays(&mesh);
+}
+
+void freeMeshData(Mesh *target) {
+    freeVertexArrays(target);
+    if (target->cache.data) {
+        unmapMeshCache(&target->cache);
+    } else {
+        array_free(target->faces);
+        array_free(target->vertices);
+    }
+    // leave the mesh empty so another one can be loaded
+    target->faces = NULL;
+    target->vertices = NULL;
 }
 
 void freeMesh(void) {
-    array_free(mesh.faces);
-    array_free(mesh.vertices);
+    freeMeshData(&mesh);
 }
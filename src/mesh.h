@@ -8,15 +8,35 @@
 #define N_CUBE_VERTICES 8
 #define N_CUBE_FACES 6 * 2 // 6 cube faces, 2 triangles per face
 
+#include <stdbool.h>
+
+#include "meshcache.h"
 #include "triangle.h"
 #include "vector.h"
 
 extern Vec3 cubeVertices[N_CUBE_VERTICES];
 extern Face cubeFaces[N_CUBE_FACES];
 
+// meshes with at least this many vertices get a structure-of-arrays copy
+// of their vertices for the batched SIMD transform
+#define MESH_VERTEX_ARRAYS_MIN_VERTICES 256
+
+///////////////////////////////////////////////////////////////////////////////
+// The vertices of a mesh as separate x, y and z arrays (structure-of-arrays).
+// Every array is 32-byte aligned so SIMD code can load 8 floats at a time.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    float* x;
+    float* y;
+    float* z;
+    int numVertices;
+} VertexArrays;
+
 typedef struct {
     Vec3* vertices;
+    VertexArrays vertexArrays;  // empty for small meshes, see MESH_VERTEX_ARRAYS_MIN_VERTICES
     Face* faces;
+    MeshCacheMapping cache;  // set when vertices and faces point into a mapped cache file
     Vec3 rotation;
     Vec3 scale;
     Vec3 translation;
@@ -26,6 +46,13 @@ extern Mesh mesh;
 
 void loadCubeMeshData(void);
 void loadOBJFileData(const char* fileName);
+void buildMeshVertexArrays(void);
 void freeMesh(void);
 
+// load an OBJ file into any mesh, like the asset loader thread does. Returns
+// false if the file cannot be read. Without the job system the file is
+// parsed on the calling thread only, and the render jobs are not delayed.
+bool loadMeshOBJFile(Mesh* target, const char* fileName, bool useJobSystem);
+void freeMeshData(Mesh* target);
+
 #endif //MESH_H
@@ -0,0 +1,315 @@
+#include "meshcache.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "array.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Layout of a cache file, every part right after the other:
+//
+//     MeshCacheHeader
+//     vertex array    ARRAY_HEADER_SIZE bytes, then numVertices Vec3
+//     face array      ARRAY_HEADER_SIZE bytes, then numFaces Face
+//
+// The arrays are written with the header array.c keeps in front of the
+// items, so array_length works on them right inside the mapping. The mesh
+// never grows them there: loading another OBJ on top of a cached mesh copies
+// them out first.
+//
+// The layout is whatever the build uses for Vec3 and Face, the header
+// records their sizes and a version to bump when they change. It also
+// records the size, the modification time and a hash of the OBJ file. When
+// the size and the time match the file the cache is used right away, when
+// only the time changed (a checkout touches every file) the OBJ is hashed to
+// tell. Anything else parses the OBJ again and rewrites the cache.
+//
+// The hash is FNV-1a over 8-byte words rather than bytes, so hashing the
+// OBJ costs a fraction of parsing it.
+///////////////////////////////////////////////////////////////////////////////
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_HASH_CHUNK (64 * 1024)  // a multiple of 8, see hashBytes
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;  // sizeof(Vec3)
+    uint32_t faceSize;    // sizeof(Face)
+    int32_t numVertices;
+    int32_t numFaces;
+    int64_t sourceSize;
+    int64_t sourceModifiedTime;
+    uint64_t sourceHash;
+} MeshCacheHeader;
+
+static const char meshCacheMagic[4] = {'S', 'R', 'M', 'C'};
+
+// hashing in pieces gives the same hash as all at once as long as every
+// piece but the last is a multiple of 8 bytes
+static uint64_t hashBytes(uint64_t hash, const char *data, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ (unsigned char) data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static bool hashFile(const char *fileName, uint64_t *hash) {
+    FILE *file = fopen(fileName, "rb");
+    char *buffer = malloc(MESH_CACHE_HASH_CHUNK);
+    bool isHashed = false;
+    if (file && buffer) {
+        *hash = FNV_OFFSET_BASIS;
+        size_t size;
+        while ((size = fread(buffer, 1, MESH_CACHE_HASH_CHUNK, file)) > 0) {
+            *hash = hashBytes(*hash, buffer, size);
+        }
+        isHashed = !ferror(file);
+    }
+    free(buffer);
+    if (file) {
+        fclose(file);
+    }
+    return isHashed;
+}
+
+static bool getCachePath(const char *objFileName, char *path, size_t size) {
+    const int length = snprintf(path, size, "%s.cache", objFileName);
+    return length > 0 && (size_t) length < size;
+}
+
+static bool mapFile(const char *fileName, MeshCacheMapping *mapping) {
+#ifdef _WIN32
+    // no mmap, the cache is read into memory instead
+    FILE *file = fopen(fileName, "rb");
+    if (!file) {
+        return false;
+    }
+    void *data = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0) {
+        rewind(file);
+        data = malloc(size);
+        if (data && fread(data, 1, size, file) != (size_t) size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    mapping->data = data;
+    mapping->size = data ? (size_t) size : 0;
+    return data != NULL;
+#else
+    const int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        data = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping keeps the file open on its own
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    mapping->data = data;
+    mapping->size = fileStat.st_size;
+    return true;
+#endif
+}
+
+void unmapMeshCache(MeshCacheMapping *mapping) {
+    if (mapping->data) {
+#ifdef _WIN32
+        free(mapping->data);
+#else
+        munmap(mapping->data, mapping->size);
+#endif
+    }
+    mapping->data = NULL;
+    mapping->size = 0;
+}
+
+// point vertices and faces at the arrays of a mapped cache, false if the
+// header or the size of the file do not match this build
+static bool findCacheArrays(const MeshCacheMapping *cache, Vec3 **vertices, Face **faces) {
+    const MeshCacheHeader *header = cache->data;
+    if (cache->size < sizeof(MeshCacheHeader) ||
+        memcmp(header->magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 ||
+        header->version != MESH_CACHE_VERSION ||
+        header->vertexSize != sizeof(Vec3) ||
+        header->faceSize != sizeof(Face) ||
+        header->numVertices < 0 || header->numFaces < 0) {
+        return false;
+    }
+
+    const size_t vertexOffset = sizeof(MeshCacheHeader) + ARRAY_HEADER_SIZE;
+    const size_t faceOffset = vertexOffset + sizeof(Vec3) * header->numVertices + ARRAY_HEADER_SIZE;
+    if (cache->size != faceOffset + sizeof(Face) * header->numFaces) {
+        return false;
+    }
+    *vertices = (Vec3 *) ((char *) cache->data + vertexOffset);
+    *faces = (Face *) ((char *) cache->data + faceOffset);
+    if (array_length(*vertices) != header->numVertices || array_length(*faces) != header->numFaces) {
+        return false;
+    }
+    // a damaged file must not send the renderer out of the vertex array
+    for (int i = 0; i < header->numFaces; i++) {
+        const Face *face = &(*faces)[i];
+        if ((unsigned) face->a >= (unsigned) header->numVertices ||
+            (unsigned) face->b >= (unsigned) header->numVertices ||
+            (unsigned) face->c >= (unsigned) header->numVertices) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isCacheOfSource(const MeshCacheHeader *header, const char *objFileName, const struct stat *sourceStat) {
+    if (header->sourceSize != (int64_t) sourceStat->st_size) {
+        return false;
+    }
+    if (header->sourceModifiedTime == (int64_t) sourceStat->st_mtime) {
+        return true;
+    }
+    uint64_t hash;
+    return hashFile(objFileName, &hash) && hash == header->sourceHash;
+}
+
+bool mapMeshCache(const char *objFileName, MeshCacheMapping *mapping, Vec3 **vertices, Face **faces) {
+    char cachePath[1024];
+    struct stat sourceStat;
+    if (!getCachePath(objFileName, cachePath, sizeof(cachePath)) || stat(objFileName, &sourceStat) != 0) {
+        return false;
+    }
+
+    MeshCacheMapping cache = {.data = NULL, .size = 0};
+    if (!mapFile(cachePath, &cache)) {
+        return false;
+    }
+    Vec3 *cachedVertices;
+    Face *cachedFaces;
+    if (!findCacheArrays(&cache, &cachedVertices, &cachedFaces) ||
+        !isCacheOfSource(cache.data, objFileName, &sourceStat)) {
+        unmapMeshCache(&cache);
+        return false;
+    }
+
+    *mapping = cache;
+    *vertices = cachedVertices;
+    *faces = cachedFaces;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Create a temporary file next to the cache and open it for writing, tmpPath
+// gets its name. Every writer gets a file of its own, two processes loading
+// the same OBJ at once do not write into each other's file.
+///////////////////////////////////////////////////////////////////////////////
+static FILE *createTemporaryFile(const char *cachePath, char *tmpPath, size_t size) {
+#ifdef _WIN32
+    static int counter = 0;
+    const int length = snprintf(tmpPath, size, "%s.%d.%d.tmp", cachePath, _getpid(), counter++);
+    if (length <= 0 || (size_t) length >= size) {
+        return NULL;
+    }
+    return fopen(tmpPath, "wb");
+#else
+    const int length = snprintf(tmpPath, size, "%s.XXXXXX", cachePath);
+    if (length <= 0 || (size_t) length >= size) {
+        return NULL;
+    }
+    const int fd = mkstemp(tmpPath);
+    if (fd < 0) {
+        return NULL;
+    }
+    // mkstemp only lets the owner read the file, the cache is shared like any
+    // other file fopen would create
+    fchmod(fd, 0644);
+    FILE *file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        remove(tmpPath);
+    }
+    return file;
+#endif
+}
+
+void writeMeshCache(
+    const char *objFileName, const struct stat *sourceStat, const char *source, size_t sourceSize,
+    Vec3 *vertices, Face *faces
+) {
+    char cachePath[1024];
+    if (!getCachePath(objFileName, cachePath, sizeof(cachePath))) {
+        return;
+    }
+    // the file changed between the stat and the read, its time may not be the one of source
+    if ((int64_t) sourceStat->st_size != (int64_t) sourceSize) {
+        return;
+    }
+
+    const int numVertices = array_length(vertices);
+    const int numFaces = array_length(faces);
+    MeshCacheHeader header = {
+        .version = MESH_CACHE_VERSION,
+        .vertexSize = sizeof(Vec3),
+        .faceSize = sizeof(Face),
+        .numVertices = numVertices,
+        .numFaces = numFaces,
+        .sourceSize = (int64_t) sourceSize,
+        .sourceModifiedTime = (int64_t) sourceStat->st_mtime,
+        .sourceHash = hashBytes(FNV_OFFSET_BASIS, source, sourceSize),
+    };
+    memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+    int vertexArrayHeader[ARRAY_HEADER_SIZE / sizeof(int)];
+    int faceArrayHeader[ARRAY_HEADER_SIZE / sizeof(int)];
+    array_place(vertexArrayHeader, numVertices);
+    array_place(faceArrayHeader, numFaces);
+
+    // the cache is written next to the old one and renamed over it when it is
+    // complete. Truncating the old file in place would pull the pages from
+    // under every process that has it mapped, they would crash on the next read
+    char tmpPath[1024 + 32];
+    FILE *file = createTemporaryFile(cachePath, tmpPath, sizeof(tmpPath));
+    if (!file) {
+        fprintf(stderr, "Error creating the mesh cache %s, loading from the OBJ every time.\n", cachePath);
+        return;
+    }
+    bool isWritten = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                     fwrite(vertexArrayHeader, ARRAY_HEADER_SIZE, 1, file) == 1 &&
+                     fwrite(vertices, sizeof(Vec3), numVertices, file) == (size_t) numVertices &&
+                     fwrite(faceArrayHeader, ARRAY_HEADER_SIZE, 1, file) == 1 &&
+                     fwrite(faces, sizeof(Face), numFaces, file) == (size_t) numFaces;
+    isWritten = fclose(file) == 0 && isWritten;
+#ifdef _WIN32
+    // rename does not replace an existing file here, nothing maps it either
+    if (isWritten) {
+        remove(cachePath);
+    }
+#endif
+    if (!isWritten || rename(tmpPath, cachePath) != 0) {
+        // a partial cache would be rejected anyway, do not leave it around
+        remove(tmpPath);
+        fprintf(stderr, "Error writing the mesh cache %s.\n", cachePath);
+    }
+}
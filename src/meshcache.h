@@ -0,0 +1,33 @@
+#ifndef SDL2_SOFTWARE_RENDERER_MESHCACHE_H
+#define SDL2_SOFTWARE_RENDERER_MESHCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#include "triangle.h"
+#include "vector.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Binary cache of a parsed OBJ file, stored next to it as <file>.cache. It
+// holds the vertex and face arrays exactly as the mesh uses them, so loading
+// it is mapping the file and pointing the mesh into it.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    void *data;  // NULL when nothing is mapped
+    size_t size;
+} MeshCacheMapping;
+
+// map the cache of objFileName and point vertices and faces into it, returns
+// false when there is no cache or it does not belong to the current file
+bool mapMeshCache(const char *objFileName, MeshCacheMapping *mapping, Vec3 **vertices, Face **faces);
+void unmapMeshCache(MeshCacheMapping *mapping);
+
+// write the cache of objFileName, source is its whole text and sourceStat the
+// stat of the file taken before source was read
+void writeMeshCache(
+    const char *objFileName, const struct stat *sourceStat, const char *source, size_t sourceSize,
+    Vec3 *vertices, Face *faces
+);
+
+#endif //SDL2_SOFTWARE_RENDERER_MESHCACHE_H
@@ -0,0 +1,223 @@
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+
+#ifdef ENABLE_PROFILING
+
+// deepest nesting of PROFILE_BEGIN on one thread
+#define PROFILE_MAX_DEPTH 32
+
+typedef enum {
+    PROFILE_EVENT_SCOPE,    // "X" complete event, start and duration
+    PROFILE_EVENT_COUNTER,  // "C" counter event, start and value
+} ProfileEventType;
+
+typedef struct {
+    const char *name;
+    ProfileEventType type;
+    uint64_t start;
+    uint64_t duration;  // the value of counters, in timestamp ticks as well
+} ProfileEvent;
+
+///////////////////////////////////////////////////////////////////////////////
+// Every thread records into its own buffer, so recording takes no lock. The
+// buffers are linked together the first time a thread records something and
+// are only read when the trace is written.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct ProfileThread {
+    struct ProfileThread *next;
+    const char *name;
+    int id;
+    ProfileEvent *events;
+    int numEvents;
+    int capacity;
+    int openEvents[PROFILE_MAX_DEPTH];
+    int depth;
+} ProfileThread;
+
+static _Thread_local ProfileThread *currentThread = NULL;
+
+static ProfileThread *threads = NULL;
+static int numThreads = 0;
+static SDL_SpinLock threadsLock = 0;
+
+static bool isProfiling = false;
+static uint64_t startTimestamp = 0;
+
+static ProfileThread *getProfileThread(void) {
+    if (!currentThread) {
+        currentThread = calloc(1, sizeof(ProfileThread));
+        SDL_AtomicLock(&threadsLock);
+        currentThread->id = ++numThreads;
+        currentThread->next = threads;
+        threads = currentThread;
+        SDL_AtomicUnlock(&threadsLock);
+    }
+    return currentThread;
+}
+
+static ProfileEvent *pushProfileEvent(ProfileThread *thread) {
+    if (thread->numEvents == thread->capacity) {
+        thread->capacity = thread->capacity == 0 ? 4096 : thread->capacity * 2;
+        thread->events = realloc(thread->events, sizeof(ProfileEvent) * thread->capacity);
+    }
+    return &thread->events[thread->numEvents++];
+}
+
+bool isProfilingAvailable(void) {
+    return true;
+}
+
+void startProfiling(void) {
+    startTimestamp = getProfileTimestamp();
+    isProfiling = true;
+}
+
+void setProfileThreadName(const char *name) {
+    getProfileThread()->name = name;
+}
+
+uint64_t getProfileTimestamp(void) {
+    return SDL_GetPerformanceCounter();
+}
+
+void beginProfileEvent(const char *name) {
+    if (!isProfiling) {
+        return;
+    }
+    ProfileThread *thread = getProfileThread();
+    if (thread->depth == PROFILE_MAX_DEPTH) {
+        // too deep, the matching endProfileEvent drops it as well
+        thread->depth++;
+        return;
+    }
+    thread->openEvents[thread->depth++] = thread->numEvents;
+    *pushProfileEvent(thread) = (ProfileEvent) {
+        .name = name,
+        .type = PROFILE_EVENT_SCOPE,
+        .start = getProfileTimestamp(),
+        .duration = 0,
+    };
+}
+
+void endProfileEvent(void) {
+    if (!isProfiling) {
+        return;
+    }
+    ProfileThread *thread = getProfileThread();
+    if (thread->depth == 0) {
+        // the event began before startProfiling
+        return;
+    }
+    thread->depth--;
+    if (thread->depth < PROFILE_MAX_DEPTH) {
+        ProfileEvent *event = &thread->events[thread->openEvents[thread->depth]];
+        event->duration = getProfileTimestamp() - event->start;
+    }
+}
+
+void addProfileCounter(const ProfileAccumulator *accumulator) {
+    if (!isProfiling) {
+        return;
+    }
+    *pushProfileEvent(getProfileThread()) = (ProfileEvent) {
+        .name = accumulator->name,
+        .type = PROFILE_EVENT_COUNTER,
+        .start = getProfileTimestamp(),
+        .duration = accumulator->total,
+    };
+}
+
+bool writeProfileTrace(const char *path) {
+    isProfiling = false;
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error opening %s to write the trace.\n", path);
+        return false;
+    }
+
+    // trace_event timestamps are in microseconds
+    const double microseconds = 1000000.0 / (double) SDL_GetPerformanceFrequency();
+    bool isFirstEvent = true;
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (ProfileThread *thread = threads; thread; thread = thread->next) {
+        if (thread->name) {
+            fprintf(
+                file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                isFirstEvent ? "" : ",\n", thread->id, thread->name
+            );
+            isFirstEvent = false;
+        }
+        for (int i = 0; i < thread->numEvents; i++) {
+            const ProfileEvent *event = &thread->events[i];
+            if (event->start < startTimestamp) {
+                continue;
+            }
+            const double timestamp = (double) (event->start - startTimestamp) * microseconds;
+            const double duration = (double) event->duration * microseconds;
+            if (event->type == PROFILE_EVENT_SCOPE) {
+                fprintf(
+                    file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    isFirstEvent ? "" : ",\n", event->name, thread->id, timestamp, duration
+                );
+            } else {
+                fprintf(
+                    file, "%s{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%.3f}}",
+                    isFirstEvent ? "" : ",\n", event->name, thread->id, timestamp, duration
+                );
+            }
+            isFirstEvent = false;
+        }
+        free(thread->events);
+        thread->events = NULL;
+        thread->numEvents = 0;
+        thread->capacity = 0;
+    }
+    fprintf(file, "\n]}\n");
+
+    const bool isWritten = !ferror(file);
+    if (fclose(file) != 0 || !isWritten) {
+        fprintf(stderr, "Error writing the trace to %s.\n", path);
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool isProfilingAvailable(void) {
+    return false;
+}
+
+void startProfiling(void) {
+}
+
+bool writeProfileTrace(const char *path) {
+    (void) path;
+    fprintf(stderr, "Profiling is not available, build with ENABLE_PROFILING to write a trace.\n");
+    return false;
+}
+
+void setProfileThreadName(const char *name) {
+    (void) name;
+}
+
+void beginProfileEvent(const char *name) {
+    (void) name;
+}
+
+void endProfileEvent(void) {
+}
+
+uint64_t getProfileTimestamp(void) {
+    return 0;
+}
+
+void addProfileCounter(const ProfileAccumulator *accumulator) {
+    (void) accumulator;
+}
+
+#endif
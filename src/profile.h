@@ -0,0 +1,76 @@
+#ifndef SDL2_SOFTWARE_RENDERER_PROFILE_H
+#define SDL2_SOFTWARE_RENDERER_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Per-stage timings of the pipeline, exported as a Chrome trace_event file
+// (chrome://tracing, https://ui.perfetto.dev). The PROFILE_* macros compile
+// to nothing unless the build defines ENABLE_PROFILING, and even then they
+// only record between startProfiling and writeProfileTrace.
+//
+//     PROFILE_BEGIN("clear");
+//     clearColorBuffer(0xFF000000);
+//     PROFILE_END();
+//
+// Steps that are too small to be an event of their own, like the culling of
+// a single face, are summed up with an accumulator and show up once per
+// frame as a counter:
+//
+//     PROFILE_ACCUMULATOR(culling, "culling us");
+//     for (...) {
+//         PROFILE_ACCUMULATE_BEGIN(culling);
+//         ...
+//         PROFILE_ACCUMULATE_END(culling);
+//     }
+//     PROFILE_COUNTER(culling);
+//
+// Accumulators of jobs that ran on other threads are added together with
+// PROFILE_ACCUMULATE_ADD before the counter is written.
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t total;
+} ProfileAccumulator;
+
+#ifdef ENABLE_PROFILING
+
+#define PROFILE_THREAD_NAME(name) setProfileThreadName(name)
+#define PROFILE_BEGIN(name) beginProfileEvent(name)
+#define PROFILE_END() endProfileEvent()
+#define PROFILE_ACCUMULATOR(variable, name) ProfileAccumulator variable = {name, 0, 0}
+#define PROFILE_ACCUMULATE_BEGIN(variable) ((variable).start = getProfileTimestamp())
+#define PROFILE_ACCUMULATE_END(variable) ((variable).total += getProfileTimestamp() - (variable).start)
+#define PROFILE_ACCUMULATE_ADD(variable, other) ((variable).total += (other).total)
+#define PROFILE_COUNTER(variable) addProfileCounter(&(variable))
+
+#else
+
+#define PROFILE_THREAD_NAME(name) ((void) 0)
+#define PROFILE_BEGIN(name) ((void) 0)
+#define PROFILE_END() ((void) 0)
+#define PROFILE_ACCUMULATOR(variable, name)
+#define PROFILE_ACCUMULATE_BEGIN(variable) ((void) 0)
+#define PROFILE_ACCUMULATE_END(variable) ((void) 0)
+#define PROFILE_ACCUMULATE_ADD(variable, other) ((void) 0)
+#define PROFILE_COUNTER(variable) ((void) 0)
+
+#endif
+
+bool isProfilingAvailable(void);
+
+// start recording the events of every thread
+void startProfiling(void);
+// stop recording and write everything recorded so far, the other threads must be idle
+bool writeProfileTrace(const char *path);
+
+void setProfileThreadName(const char *name);
+void beginProfileEvent(const char *name);
+void endProfileEvent(void);
+uint64_t getProfileTimestamp(void);
+void addProfileCounter(const ProfileAccumulator *accumulator);
+
+#endif //SDL2_SOFTWARE_RENDERER_PROFILE_H
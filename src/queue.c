@@ -0,0 +1,72 @@
+#include "queue.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// capacity of the queue before any frame has been seen
+#define RENDER_QUEUE_MIN_CAPACITY 1024
+
+static bool reserveTriangles(RenderQueue *queue, int capacity) {
+    ScreenTriangle *triangles = arenaAlloc(&queue->arena, sizeof(ScreenTriangle) * capacity);
+    if (!triangles) {
+        return false;
+    }
+    if (queue->numTriangles > 0) {
+        memcpy(triangles, queue->triangles, sizeof(ScreenTriangle) * queue->numTriangles);
+    }
+    queue->triangles = triangles;
+    queue->capacity = capacity;
+    return true;
+}
+
+void initRenderQueue(RenderQueue *queue) {
+    initArena(&queue->arena);
+    queue->triangles = NULL;
+    queue->numTriangles = 0;
+    queue->capacity = 0;
+}
+
+void freeRenderQueue(RenderQueue *queue) {
+    freeArena(&queue->arena);
+    initRenderQueue(queue);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Empty the queue for a new frame. The array is reserved right away for as
+// many triangles as fit the memory the arena kept for its high-water mark,
+// so a steady scene never grows it again. That is at least as many as the
+// busiest frame so far, the arena also counted the copies growing it left.
+///////////////////////////////////////////////////////////////////////////////
+void resetRenderQueue(RenderQueue *queue) {
+    arenaReset(&queue->arena);
+    queue->triangles = NULL;
+    queue->numTriangles = 0;
+    queue->capacity = 0;
+
+    const size_t capacity = queue->arena.highWater / sizeof(ScreenTriangle);
+    reserveTriangles(queue, capacity > RENDER_QUEUE_MIN_CAPACITY ? (int) capacity : RENDER_QUEUE_MIN_CAPACITY);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Append count triangles at once and return the first of them to be filled in
+// place, or NULL if there is no memory left for them
+///////////////////////////////////////////////////////////////////////////////
+// A frame with more triangles than any before moves the array to a big enough
+// one further in the arena, doubling the capacity. The old copy stays there
+// until the reset, the arena grows to fit both and the next frames reserve the
+// new size at once.
+///////////////////////////////////////////////////////////////////////////////
+ScreenTriangle *renderQueuePushMany(RenderQueue *queue, int count) {
+    if (queue->numTriangles + count > queue->capacity) {
+        int capacity = queue->capacity == 0 ? RENDER_QUEUE_MIN_CAPACITY : queue->capacity;
+        while (capacity < queue->numTriangles + count) {
+            capacity *= 2;
+        }
+        if (!reserveTriangles(queue, capacity)) {
+            return NULL;
+        }
+    }
+    ScreenTriangle *triangles = &queue->triangles[queue->numTriangles];
+    queue->numTriangles += count;
+    return triangles;
+}
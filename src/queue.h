@@ -0,0 +1,25 @@
+#ifndef SDL2_SOFTWARE_RENDERER_QUEUE_H
+#define SDL2_SOFTWARE_RENDERER_QUEUE_H
+
+#include "arena.h"
+#include "triangle.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// The triangles of one frame, ready to be rasterized. The array lives in a
+// per-frame arena and is always contiguous, so it can be handed over to the
+// tile renderer as it is.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    Arena arena;
+    ScreenTriangle *triangles;
+    int numTriangles;
+    int capacity;
+} RenderQueue;
+
+void initRenderQueue(RenderQueue *queue);
+void freeRenderQueue(RenderQueue *queue);
+
+void resetRenderQueue(RenderQueue *queue);
+ScreenTriangle *renderQueuePushMany(RenderQueue *queue, int count);
+
+#endif //SDL2_SOFTWARE_RENDERER_QUEUE_H
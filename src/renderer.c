@@ -0,0 +1,560 @@
+#include "renderer.h"
+
+#include <SDL2/SDL.h>
+
+#include "array.h"
+#include "camera.h"
+#include "clipping.h"
+#include "display.h"
+#include "job.h"
+#include "light.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "profile.h"
+#include "queue.h"
+#include "span.h"
+#include "stats.h"
+#include "texture.h"
+#include "tiles.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// The rendering pipeline of a frame, without any window or input handling so
+// it can be driven by the interactive program as well as by the headless
+// tools: processGeometry turns the mesh into the render queue of the frame,
+// rasterizeFrame draws the queue into the color buffer.
+//
+// The queue is double buffered so the two can run at the same time on
+// different threads: processGeometry fills geometryFrame while rasterizeFrame
+// reads rasterFrame, and swapRenderQueues hands the new frame over once both
+// are done. Called one after the other, the swap goes in between.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    // the triangles of the frame, in a per-frame arena with no fixed limit
+    RenderQueue queue;
+    // the geometry counts of the frame, rasterizeFrame adds its own to them
+    PipelineStats stats;
+} FrameGeometry;
+
+static FrameGeometry frameGeometry[2];
+static FrameGeometry *geometryFrame = &frameGeometry[0];
+static FrameGeometry *rasterFrame = &frameGeometry[1];
+
+static Mat4 projectionMatrix;
+
+// view space vertices of the mesh for the current frame and their frustum outcodes
+static Vec4 *transformedVertices = NULL;
+static uint16_t *vertexOutcodes = NULL;
+static int transformedVerticesCapacity = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// The geometry stage runs as jobs: first chunks of vertices are transformed,
+// then chunks of faces are culled and clipped, then projected. Culling and
+// clipping only keep a short record of every face that is left, so the
+// number of triangles of each chunk is known before any is projected.
+// processGeometry reserves them all in the queue of the frame at once and
+// every chunk projects its triangles straight into its own range, at the sum
+// of the counts of the chunks before it. The triangles end up in the same
+// order as with a single loop over the faces, whatever thread ran each chunk.
+///////////////////////////////////////////////////////////////////////////////
+#define GEOMETRY_VERTEX_CHUNK 4096
+#define GEOMETRY_FACE_CHUNK 1024
+
+// a face that survived culling and clipping, waiting to be projected
+typedef struct {
+    int face;            // index into mesh.faces
+    int firstClipped;    // first of its triangles in clippedTriangles, -1 if it was not clipped
+    int numTriangles;
+    uint32_t color;      // the color of the face, lit already
+} VisibleFace;
+
+typedef struct {
+    VisibleFace *visibleFaces;  // room for GEOMETRY_FACE_CHUNK
+    int numVisibleFaces;
+    Triangle *clippedTriangles;
+    int numClippedTriangles;
+    int clippedTrianglesCapacity;
+    // where the triangles of the chunk go in the queue of the frame, NULL if
+    // there was no memory left for them
+    ScreenTriangle *triangles;
+    int numTriangles;
+    PipelineStats stats;
+    // summed up over all the chunks for the counters of the frame
+    ProfileAccumulator cullingTime;
+    ProfileAccumulator clippingTime;
+    ProfileAccumulator projectionTime;
+} FaceChunk;
+
+static FaceChunk *faceChunks = NULL;
+static int faceChunksCapacity = 0;
+
+// the same for the whole mesh, set before the geometry jobs start
+static Mat4 worldViewMatrix;
+
+// the rows of the frame buffers are cleared and post-processed in bands of
+// this many rows, one job each
+#define FRAME_BAND_ROWS TILE_SIZE
+
+// the counts of the last rasterized frame and their sum since resetTotalStats
+static PipelineStats frameStats;
+static PipelineStats totalStats;
+
+void initRenderer(int numThreads) {
+    // init perspective projection matrix
+    const float aspectX = (float) getWindowWidth() / (float) getWindowHeight();
+    const float aspectY = (float) getWindowHeight() / (float) getWindowWidth();
+    const float fovY = M_PI / 3.0f;  // the same as 180/3, or 60 degrees
+    const float fovX = 2.0f * atanf(tanf(fovY / 2.0f) * aspectX);
+    const float zNear = 1.f;
+    const float zFar = 20.0f;
+    projectionMatrix = mat4_makePerspective(fovY, aspectY, zNear, zFar);
+
+    // init the frustum planes
+    initFrustumPlanes(fovX, fovY, zNear, zFar);
+
+    // pick the SIMD scanline kernels for this CPU and start the threads the
+    // geometry and the tiles are processed on, the main thread included
+    initSpanFunctions();
+    initJobSystem(numThreads);
+    initRenderQueue(&frameGeometry[0].queue);
+    initRenderQueue(&frameGeometry[1].queue);
+    clearPipelineStats(&frameGeometry[0].stats);
+    clearPipelineStats(&frameGeometry[1].stats);
+}
+
+void destroyRenderer(void) {
+    destroyJobSystem();
+    destroyTileRenderer();
+    for (int i = 0; i < faceChunksCapacity; i++) {
+        free(faceChunks[i].visibleFaces);
+        free(faceChunks[i].clippedTriangles);
+    }
+    free(faceChunks);
+    faceChunks = NULL;
+    faceChunksCapacity = 0;
+    freeRenderQueue(&frameGeometry[0].queue);
+    freeRenderQueue(&frameGeometry[1].queue);
+    free(transformedVertices);
+    free(vertexOutcodes);
+    transformedVertices = NULL;
+    vertexOutcodes = NULL;
+    transformedVerticesCapacity = 0;
+}
+
+static void transformVerticesJob(void *data, int chunkIndex) {
+    (void) data;
+    const int first = chunkIndex * GEOMETRY_VERTEX_CHUNK;
+    const int count = SDL_min(GEOMETRY_VERTEX_CHUNK, array_length(mesh.vertices) - first);
+
+    PROFILE_BEGIN("transform");
+    if (mesh.vertexArrays.numVertices == array_length(mesh.vertices)) {
+        // big meshes go through the SIMD batch, 4 or 8 vertices at a time
+        mat4_mulVec4Batch(
+            &worldViewMatrix,
+            mesh.vertexArrays.x + first, mesh.vertexArrays.y + first, mesh.vertexArrays.z + first,
+            transformedVertices + first,
+            count
+        );
+    } else {
+        for (int i = first; i < first + count; i++) {
+            transformedVertices[i] = mat4_mulVec4(worldViewMatrix, vec4_fromVec3(mesh.vertices[i]));
+        }
+    }
+    PROFILE_END();
+
+    PROFILE_BEGIN("outcodes");
+    for (int i = first; i < first + count; i++) {
+        vertexOutcodes[i] = computeFrustumOutcode(vec3_fromVec4(transformedVertices[i]));
+    }
+    PROFILE_END();
+}
+
+// make room for the triangles of one more clipped face at the end of clippedTriangles
+static Triangle *reserveClippedTriangles(FaceChunk *chunk) {
+    if (chunk->numClippedTriangles + MAX_NUM_POLY_TRIANGLES > chunk->clippedTrianglesCapacity) {
+        int capacity = chunk->clippedTrianglesCapacity == 0 ? 64 : chunk->clippedTrianglesCapacity * 2;
+        chunk->clippedTriangles = realloc(chunk->clippedTriangles, sizeof(Triangle) * capacity);
+        chunk->clippedTrianglesCapacity = capacity;
+    }
+    return &chunk->clippedTriangles[chunk->numClippedTriangles];
+}
+
+static void cullAndClipFacesJob(void *data, int chunkIndex) {
+    (void) data;
+    PROFILE_BEGIN("faces");
+    FaceChunk *chunk = &faceChunks[chunkIndex];
+    PipelineStats *stats = &chunk->stats;
+    chunk->numVisibleFaces = 0;
+    chunk->numClippedTriangles = 0;
+    chunk->numTriangles = 0;
+    clearPipelineStats(stats);
+    chunk->cullingTime.total = 0;
+    chunk->clippingTime.total = 0;
+    chunk->projectionTime.total = 0;
+
+    const int first = chunkIndex * GEOMETRY_FACE_CHUNK;
+    const int end = SDL_min(first + GEOMETRY_FACE_CHUNK, array_length(mesh.faces));
+    for (int i = first; i < end; i++) {
+        PROFILE_ACCUMULATE_BEGIN(chunk->cullingTime);
+        const Face meshFace = mesh.faces[i];
+        stats->facesSubmitted++;
+
+        // reject the triangle right away when all its vertices are outside of the same frustum plane
+        const uint16_t outcodeA = vertexOutcodes[meshFace.a];
+        const uint16_t outcodeB = vertexOutcodes[meshFace.b];
+        const uint16_t outcodeC = vertexOutcodes[meshFace.c];
+        if ((outcodeA & outcodeB & outcodeC & FRUSTUM_OUTCODE_MASK) != 0) {
+            stats->facesRejected++;
+            PROFILE_ACCUMULATE_END(chunk->cullingTime);
+            continue;
+        }
+
+        const Vec4 faceVertices[] = {
+            transformedVertices[meshFace.a],
+            transformedVertices[meshFace.b],
+            transformedVertices[meshFace.c],
+        };
+
+        // triangle culling
+        /*   A
+         *  /  \
+         * B----C */
+        const Vec3 vectorA = vec3_fromVec4(faceVertices[0]);
+        const Vec3 vectorB = vec3_fromVec4(faceVertices[1]);
+        const Vec3 vectorC = vec3_fromVec4(faceVertices[2]);
+        Vec3 vectorAB = vec3_sub(vectorB, vectorA);
+        Vec3 vectorAC = vec3_sub(vectorC, vectorA);
+        vec3_normalize(&vectorAB);
+        vec3_normalize(&vectorAC);
+
+        // compute face normal using the cross product to find the perpendicular.
+        // the order matters, we are using a left-handed coordinate system (Z
+        // grows inside the screen).
+        Vec3 normal = vec3_cross(vectorAB, vectorAC);
+
+        // normalize the normal
+        vec3_normalize(&normal);
+
+        Vec3 origin = {0, 0, 0};
+        // find the vector between a point in the triangle and the camera origin
+        const Vec3 cameraRay = vec3_sub(origin, vectorA);
+
+        if (getCullMethod() == CULL_BACKFACE) {
+            // check if this triangle is aligned with the screen
+            // bypass the triangles that are looking away from the camera
+            if (vec3_dot(normal, cameraRay) < 0) {
+                stats->facesCulled++;
+                PROFILE_ACCUMULATE_END(chunk->cullingTime);
+                continue;
+            }
+        }
+        PROFILE_ACCUMULATE_END(chunk->cullingTime);
+
+        PROFILE_ACCUMULATE_BEGIN(chunk->clippingTime);
+
+        // the number of triangles left after clipping, just the original one when it
+        // is not clipped. Clipped faces are split straight into the triangles of the
+        // chunk, the projection reads them from there
+        int numTrianglesAfterClipping = 1;
+
+        const uint16_t clipPlanes = selectClipPlanes(outcodeA | outcodeB | outcodeC);
+        if (clipPlanes != 0) {
+            // Clipping
+            // the triangle crosses at least one of the planes it has to be clipped against
+            Polygon polygon = createPolygonFromTriangle(
+                vectorA,
+                vectorB,
+                vectorC,
+                meshFace.vertexA_UV,
+                meshFace.vertexB_UV,
+                meshFace.vertexC_UV
+            );
+
+            clipPolygonAgainstPlanes(&polygon, clipPlanes);
+
+            // break the polygon into triangles
+            createTrianglesFromPolygon(&polygon, reserveClippedTriangles(chunk), &numTrianglesAfterClipping);
+
+            stats->facesClipped++;
+            stats->trianglesFromClipping += numTrianglesAfterClipping;
+            if (numTrianglesAfterClipping == 0) {
+                stats->facesClippedAway++;
+            }
+        }
+        PROFILE_ACCUMULATE_END(chunk->clippingTime);
+        if (numTrianglesAfterClipping == 0) {
+            continue;
+        }
+
+        // Calculate the shade of the triangle based on the direction of the light
+        // and the normal of the face.
+        // we need the inverse of the normal to calculate the light intensity because
+        // our Z grows towards the screen, not from the screen.
+        float lightIntensityFactor = -1 * vec3_dot(normal, light.direction);
+
+        int firstClipped = -1;
+        if (clipPlanes != 0) {
+            firstClipped = chunk->numClippedTriangles;
+            chunk->numClippedTriangles += numTrianglesAfterClipping;
+        }
+        chunk->visibleFaces[chunk->numVisibleFaces++] = (VisibleFace) {
+            .face = i,
+            .firstClipped = firstClipped,
+            .numTriangles = numTrianglesAfterClipping,
+            .color = lightApplyIntensity(meshFace.color, lightIntensityFactor),
+        };
+        chunk->numTriangles += numTrianglesAfterClipping;
+    }
+    PROFILE_END();
+}
+
+static void projectFacesJob(void *data, int chunkIndex) {
+    (void) data;
+    FaceChunk *chunk = &faceChunks[chunkIndex];
+    if (!chunk->triangles) {
+        return;
+    }
+    PROFILE_BEGIN("projection");
+    PROFILE_ACCUMULATE_BEGIN(chunk->projectionTime);
+    ScreenTriangle *triangleToRender = chunk->triangles;
+    for (int i = 0; i < chunk->numVisibleFaces; i++) {
+        const VisibleFace *visibleFace = &chunk->visibleFaces[i];
+
+        // a face that was not clipped is projected from the transformed vertices as it is
+        Triangle unclippedTriangle;
+        const Triangle *clippedTriangles = &unclippedTriangle;
+        if (visibleFace->firstClipped < 0) {
+            const Face meshFace = mesh.faces[visibleFace->face];
+            unclippedTriangle = (Triangle) {
+                .points = {
+                    transformedVertices[meshFace.a],
+                    transformedVertices[meshFace.b],
+                    transformedVertices[meshFace.c],
+                },
+                .textCoords = {meshFace.vertexA_UV, meshFace.vertexB_UV, meshFace.vertexC_UV},
+            };
+        } else {
+            clippedTriangles = &chunk->clippedTriangles[visibleFace->firstClipped];
+        }
+
+        // loop all the triangles after clipping, each is written in place in the render queue
+        for (int t = 0; t < visibleFace->numTriangles; t++, triangleToRender++) {
+            const Triangle *clippedTriangle = &clippedTriangles[t];
+
+            // loop all three vertices to perform projection
+            for (int j = 0; j < 3; j++) {
+                Vec4 projectedPoint = mat4_mulVec4Project(projectionMatrix, clippedTriangle->points[j]);
+
+
+                // in screen space, invert Y values to account for flipped screen coordinates
+                projectedPoint.y *= -1;
+
+                // Scale into the viewport (has to go first)
+                projectedPoint.x *= (float) getWindowWidth() / 2.0f;
+                projectedPoint.y *= (float) getWindowHeight() / 2.0f;
+
+                // translate the projected points to the middle of the screen
+                projectedPoint.x += (float) getWindowWidth() / 2.0f;
+                projectedPoint.y += (float) getWindowHeight() / 2.0f;
+
+                triangleToRender->vertices[j] = packScreenVertex(projectedPoint, clippedTriangle->textCoords[j]);
+            }
+
+            triangleToRender->color = visibleFace->color;
+        }
+    }
+    PROFILE_ACCUMULATE_END(chunk->projectionTime);
+    PROFILE_END();
+}
+
+void processGeometry(void) {
+    PROFILE_BEGIN("geometry");
+
+    // reset the triangles to render for the current frame
+    RenderQueue *renderQueue = &geometryFrame->queue;
+    PipelineStats *stats = &geometryFrame->stats;
+    resetRenderQueue(renderQueue);
+    clearPipelineStats(stats);
+
+    // create the view matrix
+    Vec3 upDuration = {0, 1, 0};
+    Vec3 target = getCameraLookAtTarget();
+    Mat4 viewMatrix = mat4_lookAt(getCameraPosition(), target, upDuration);
+
+    // the world and view matrices are the same for the whole mesh, combine them once
+    Mat4 worldMatrix = mat4_makeWorld(mesh.translation, mesh.rotation, mesh.scale);
+    worldViewMatrix = mat4_mulMat4(viewMatrix, worldMatrix);
+
+    // transform every vertex of the mesh once, faces index into the transformed
+    // vertices instead of transforming their three vertices again and again
+    const int numVertices = array_length(mesh.vertices);
+    if (numVertices > transformedVerticesCapacity) {
+        transformedVertices = realloc(transformedVertices, sizeof(Vec4) * numVertices);
+        vertexOutcodes = realloc(vertexOutcodes, sizeof(uint16_t) * numVertices);
+        transformedVerticesCapacity = numVertices;
+    }
+    runJobs(transformVerticesJob, NULL, (numVertices + GEOMETRY_VERTEX_CHUNK - 1) / GEOMETRY_VERTEX_CHUNK);
+
+    const int numFaceChunks = (array_length(mesh.faces) + GEOMETRY_FACE_CHUNK - 1) / GEOMETRY_FACE_CHUNK;
+    if (numFaceChunks > faceChunksCapacity) {
+        faceChunks = realloc(faceChunks, sizeof(FaceChunk) * numFaceChunks);
+        for (int i = faceChunksCapacity; i < numFaceChunks; i++) {
+            faceChunks[i] = (FaceChunk) {
+                .visibleFaces = malloc(sizeof(VisibleFace) * GEOMETRY_FACE_CHUNK),
+            };
+        }
+        faceChunksCapacity = numFaceChunks;
+    }
+    runJobs(cullAndClipFacesJob, NULL, numFaceChunks);
+
+    // every chunk gets the range of the queue after the ones of the chunks
+    // before it, all reserved at once
+    int numTriangles = 0;
+    for (int i = 0; i < numFaceChunks; i++) {
+        numTriangles += faceChunks[i].numTriangles;
+    }
+    ScreenTriangle *triangles = numTriangles > 0 ? renderQueuePushMany(renderQueue, numTriangles) : NULL;
+    if (!triangles) {
+        stats->trianglesDropped += numTriangles;
+    }
+    for (int i = 0; i < numFaceChunks; i++) {
+        faceChunks[i].triangles = triangles;
+        if (triangles) {
+            triangles += faceChunks[i].numTriangles;
+        }
+    }
+    runJobs(projectFacesJob, NULL, numFaceChunks);
+
+    // culling and clipping alternate for every face, their times and the
+    // projection time are summed up over all the chunks, on all the threads
+    PROFILE_BEGIN("merge");
+    PROFILE_ACCUMULATOR(cullingTime, "culling us");
+    PROFILE_ACCUMULATOR(clippingTime, "clipping us");
+    PROFILE_ACCUMULATOR(projectionTime, "projection us");
+    for (int i = 0; i < numFaceChunks; i++) {
+        const FaceChunk *chunk = &faceChunks[i];
+        addPipelineStats(stats, &chunk->stats);
+        PROFILE_ACCUMULATE_ADD(cullingTime, chunk->cullingTime);
+        PROFILE_ACCUMULATE_ADD(clippingTime, chunk->clippingTime);
+        PROFILE_ACCUMULATE_ADD(projectionTime, chunk->projectionTime);
+    }
+    stats->trianglesQueued = renderQueue->numTriangles;
+    PROFILE_COUNTER(cullingTime);
+    PROFILE_COUNTER(clippingTime);
+    PROFILE_COUNTER(projectionTime);
+    PROFILE_END();
+
+    PROFILE_END();
+}
+
+void swapRenderQueues(void) {
+    FrameGeometry *tmp = geometryFrame;
+    geometryFrame = rasterFrame;
+    rasterFrame = tmp;
+}
+
+static void clearBandJob(void *data, int band) {
+    (void) data;
+    const int minY = band * FRAME_BAND_ROWS;
+    const int maxY = SDL_min(minY + FRAME_BAND_ROWS, getWindowHeight()) - 1;
+    if (shouldRenderOverdraw()) {
+        // the color buffer counts the shaded pixels until shadeOverdrawHeatmap
+        clearColorBufferRows(0, minY, maxY);
+    } else {
+        clearColorBufferRows(0xFF000000, minY, maxY);
+        drawGridRows(minY, maxY);
+    }
+    clearZBufferRows(minY, maxY);
+}
+
+static void shadeHeatmapBandJob(void *data, int band) {
+    (void) data;
+    const int minY = band * FRAME_BAND_ROWS;
+    const int maxY = SDL_min(minY + FRAME_BAND_ROWS, getWindowHeight()) - 1;
+    shadeOverdrawHeatmapRows(minY, maxY);
+}
+
+void rasterizeFrame(void) {
+    const RenderQueue *renderQueue = &rasterFrame->queue;
+    frameStats = rasterFrame->stats;
+
+    const int numBands = (getWindowHeight() + FRAME_BAND_ROWS - 1) / FRAME_BAND_ROWS;
+
+    PROFILE_BEGIN("clear");
+    // draw straight into the window texture, renderColorBuffer unlocks it
+    lockColorBuffer();
+    runJobs(clearBandJob, NULL, numBands);
+    PROFILE_END();
+
+    // rasterize the filled and textured triangles in parallel, one tile per thread
+    if (shouldRenderFilledTriangle() || shouldRenderTexturedTriangle() || shouldRenderOverdraw()) {
+        PROFILE_BEGIN("rasterize");
+        renderTrianglesInTiles(renderQueue->triangles, renderQueue->numTriangles, meshTexture, &frameStats);
+        PROFILE_END();
+    }
+
+    if (shouldRenderOverdraw()) {
+        PROFILE_BEGIN("heatmap");
+        runJobs(shadeHeatmapBandJob, NULL, numBands);
+        PROFILE_END();
+    }
+
+    // the wireframe and vertices are drawn on top of the rasterized triangles
+    PROFILE_BEGIN("overlays");
+    for (int i = 0; i < renderQueue->numTriangles; i++) {
+        const ScreenVertex *vertices = renderQueue->triangles[i].vertices;
+
+        if (shouldRenderWireframe()) {
+            Vec2 a = {vertices[0].x, vertices[0].y};
+            Vec2 b = {vertices[1].x, vertices[1].y};
+            Vec2 c = {vertices[2].x, vertices[2].y};
+            drawTriangle(a, b, c, 0xFFFFFFF);
+        }
+
+        if (shouldRenderWireVertex()) {
+            const uint32_t dotColor = 0xFFFF0000;
+            drawRect(
+                vertices[0].x - 3,
+                vertices[0].y - 3,
+                6,
+                6,
+                dotColor
+            );
+            drawRect(
+                vertices[1].x - 3,
+                vertices[1].y - 3,
+                6,
+                6,
+                dotColor
+            );
+            drawRect(
+                vertices[2].x - 3,
+                vertices[2].y - 3,
+                6,
+                6,
+                dotColor
+            );
+        }
+    }
+    PROFILE_END();
+
+    frameStats.frames = 1;
+    frameStats.pixels = (uint64_t) getWindowWidth() * getWindowHeight();
+    addPipelineStats(&totalStats, &frameStats);
+}
+
+// the triangles of the frame rasterizeFrame draws
+int getNumTrianglesToRender(void) {
+    return rasterFrame->queue.numTriangles;
+}
+
+const PipelineStats *getFrameStats(void) {
+    return &frameStats;
+}
+
+const PipelineStats *getTotalStats(void) {
+    return &totalStats;
+}
+
+void resetTotalStats(void) {
+    clearPipelineStats(&totalStats);
+}
@@ -0,0 +1,26 @@
+#ifndef SDL2_SOFTWARE_RENDERER_RENDERER_H
+#define SDL2_SOFTWARE_RENDERER_RENDERER_H
+
+#include "stats.h"
+
+// needs the display to be initialized, its size sets the projection. Runs
+// on numThreads threads, the calling one included, 0 for one per core.
+void initRenderer(int numThreads);
+void destroyRenderer(void);
+
+// transform, cull, clip and project the mesh into the render queue of the next frame
+void processGeometry(void);
+// make the queue processGeometry filled the one rasterizeFrame draws, neither may be running
+void swapRenderQueues(void);
+// draw the render queue of the current frame into the color buffer, can run
+// on another thread at the same time as processGeometry
+void rasterizeFrame(void);
+
+int getNumTrianglesToRender(void);
+
+// what the pipeline did in the last frame, and in all the frames since resetTotalStats
+const PipelineStats *getFrameStats(void);
+const PipelineStats *getTotalStats(void);
+void resetTotalStats(void);
+
+#endif //SDL2_SOFTWARE_RENDERER_RENDERER_H
@@ -0,0 +1,49 @@
+#ifndef SDL2_SOFTWARE_RENDERER_SIMD_H
+#define SDL2_SOFTWARE_RENDERER_SIMD_H
+
+///////////////////////////////////////////////////////////////////////////////
+// SIMD code paths are only compiled on x86. Each SIMD function is compiled
+// for its own instruction set with SIMD_TARGET, so the rest of the program is
+// still built for the baseline CPU, and callers pick a path at runtime with
+// SDL_HasSSE41() / SDL_HasAVX2().
+///////////////////////////////////////////////////////////////////////////////
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(features) __attribute__((target(features)))
+#else
+#define SIMD_TARGET(features)
+#endif
+
+// number of lanes set in a mask from movemask
+static inline int countMaskLanes(int mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount((unsigned) mask);
+#else
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+// index of the lowest lane set in a mask from movemask, mask must not be 0
+static inline int firstMaskLane(int mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz((unsigned) mask);
+#else
+    int lane = 0;
+    for (; (mask & 1) == 0; mask >>= 1) {
+        lane++;
+    }
+    return lane;
+#endif
+}
+
+#endif //SDL2_SOFTWARE_RENDERER_SIMD_H
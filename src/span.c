@@ -0,0 +1,485 @@
+#include "span.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+
+#include "simd.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Scanline kernels
+///////////////////////////////////////////////////////////////////////////////
+// A span is the row of the triangle's bounding box between minX and maxX.
+// For every pixel of the span a kernel checks coverage with the edge
+// functions, runs the depth test against the z-buffer, and writes the color
+// and the new depth of the pixels that pass.
+//
+// The scalar kernels do this one pixel at a time. The SSE4.1 and AVX2 kernels
+// do the same work for 4 and 8 pixels at once: coverage, depth test, UVs and
+// the texel fetch are computed for all lanes, and only the lanes that are
+// covered and pass the depth test are stored back.
+///////////////////////////////////////////////////////////////////////////////
+
+static void drawFilledSpanScalar(const Span *span) {
+    int edge0 = span->edge[0];
+    int edge1 = span->edge[1];
+    int edge2 = span->edge[2];
+    float reciprocalW = span->reciprocalW;
+    int covered = 0;
+    int passed = 0;
+
+    for (int x = span->minX; x <= span->maxX; x++) {
+        // the pixel is covered when no edge function is negative
+        if ((edge0 | edge1 | edge2) >= 0) {
+            covered++;
+            // adjust 1/w so the pixels that are closer to the camera have smaller values
+            const float depth = 1.0f - reciprocalW;
+
+            // only draw the pixel if the depth value is less than the one previously stored in the z-buffer
+            if (depth < span->zRow[x]) {
+                passed++;
+                span->colorRow[x] = span->color;
+                span->zRow[x] = depth;
+            }
+        }
+        edge0 += span->edgeStepX[0];
+        edge1 += span->edgeStepX[1];
+        edge2 += span->edgeStepX[2];
+        reciprocalW += span->reciprocalWStepX;
+    }
+    span->stats->depthPassed += passed;
+    span->stats->depthFailed += covered - passed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// abs(coordinate) % size, the same wrapping wrapTextureCoordinateSSE41 and
+// wrapTextureCoordinateAVX2 do. Huge and NaN coordinates do not fit an int,
+// converting them is undefined, they take the first texel instead.
+///////////////////////////////////////////////////////////////////////////////
+static int wrapTextureCoordinate(float coordinate, int size) {
+    const float magnitude = fabsf(coordinate);
+    if (!(magnitude < (float) INT32_MAX)) {
+        return 0;
+    }
+    return (int) magnitude % size;
+}
+
+static void drawTexturedSpanScalar(const Span *span) {
+    int edge0 = span->edge[0];
+    int edge1 = span->edge[1];
+    int edge2 = span->edge[2];
+    float reciprocalW = span->reciprocalW;
+    float uOverW = span->uOverW;
+    float vOverW = span->vOverW;
+    const int textureWidth = span->textureWidth;
+    const int textureHeight = span->textureHeight;
+    int covered = 0;
+    int passed = 0;
+
+    for (int x = span->minX; x <= span->maxX; x++) {
+        const float depth = 1.f - reciprocalW;
+        const bool isCovered = (edge0 | edge1 | edge2) >= 0;
+        covered += isCovered;
+
+        // testing the depth first skips the texture lookup of hidden pixels
+        if (isCovered && depth < span->zRow[x]) {
+            passed++;
+            // one division per pixel to go back from u/w and v/w to u and v
+            const float w = 1.f / reciprocalW;
+            const float interpolatedU = uOverW * w;
+            const float interpolatedV = vOverW * w;
+
+            // The modulus is to wrap around the texture if it goes out of bounds, this
+            // is a bit of a hack, but it works for this demo.
+            int textureX = wrapTextureCoordinate(interpolatedU * textureWidth, textureWidth);
+            int textureY = wrapTextureCoordinate(interpolatedV * textureHeight, textureHeight);
+
+            uint32_t texelIndex = (textureY * textureWidth) + textureX;
+            // make sure we don't go out of bounds
+            if (texelIndex < (uint32_t) (textureWidth * textureHeight)) {
+                span->colorRow[x] = span->texture[texelIndex];
+                span->zRow[x] = depth;
+            }
+        }
+        edge0 += span->edgeStepX[0];
+        edge1 += span->edgeStepX[1];
+        edge2 += span->edgeStepX[2];
+        reciprocalW += span->reciprocalWStepX;
+        uOverW += span->uOverWStepX;
+        vOverW += span->vOverWStepX;
+    }
+    span->stats->depthPassed += passed;
+    span->stats->depthFailed += covered - passed;
+    span->stats->texelsFetched += passed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// The filled kernel with the color write replaced by an increment, so every
+// pixel ends up with the number of times it was shaded. Only used by the
+// overdraw view, so there is no SIMD version of it.
+///////////////////////////////////////////////////////////////////////////////
+void drawOverdrawSpan(const Span *span) {
+    int edge0 = span->edge[0];
+    int edge1 = span->edge[1];
+    int edge2 = span->edge[2];
+    float reciprocalW = span->reciprocalW;
+    int covered = 0;
+    int passed = 0;
+
+    for (int x = span->minX; x <= span->maxX; x++) {
+        if ((edge0 | edge1 | edge2) >= 0) {
+            covered++;
+            const float depth = 1.0f - reciprocalW;
+            if (depth < span->zRow[x]) {
+                passed++;
+                span->colorRow[x]++;
+                span->zRow[x] = depth;
+            }
+        }
+        edge0 += span->edgeStepX[0];
+        edge1 += span->edgeStepX[1];
+        edge2 += span->edgeStepX[2];
+        reciprocalW += span->reciprocalWStepX;
+    }
+    span->stats->depthPassed += passed;
+    span->stats->depthFailed += covered - passed;
+}
+
+#if SIMD_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// Hand the pixels from x to the end of the span over to the scalar kernel
+///////////////////////////////////////////////////////////////////////////////
+static void drawSpanTailScalar(const Span *span, int x, SpanFunction scalarFunction) {
+    if (x > span->maxX) {
+        return;
+    }
+    const int offset = x - span->minX;
+    Span tail = *span;
+    tail.minX = x;
+    for (int i = 0; i < 3; i++) {
+        tail.edge[i] += offset * span->edgeStepX[i];
+    }
+    tail.reciprocalW += (float) offset * span->reciprocalWStepX;
+    tail.uOverW += (float) offset * span->uOverWStepX;
+    tail.vOverW += (float) offset * span->vOverWStepX;
+    scalarFunction(&tail);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// abs(coordinate) % size for every lane, the same wrapping the scalar kernel
+// does. The quotient comes from a float multiply by 1/size, which can be off
+// by one, so the remainder is fixed up afterwards. Huge and NaN UVs convert to
+// INT32_MIN, which abs leaves negative, those lanes take the first texel as
+// in wrapTextureCoordinate. The final clamp keeps every lane inside the texture.
+///////////////////////////////////////////////////////////////////////////////
+SIMD_TARGET("sse4.1")
+static __m128i wrapTextureCoordinateSSE41(__m128i coordinate, int size) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sizes = _mm_set1_epi32(size);
+    const __m128i lastCoordinate = _mm_set1_epi32(size - 1);
+
+    coordinate = _mm_max_epi32(_mm_abs_epi32(coordinate), zero);
+    const __m128 quotientF = _mm_mul_ps(_mm_cvtepi32_ps(coordinate), _mm_set1_ps(1.f / (float) size));
+    const __m128i quotient = _mm_cvttps_epi32(quotientF);
+    __m128i remainder = _mm_sub_epi32(coordinate, _mm_mullo_epi32(quotient, sizes));
+    remainder = _mm_add_epi32(remainder, _mm_and_si128(_mm_cmplt_epi32(remainder, zero), sizes));
+    remainder = _mm_sub_epi32(remainder, _mm_and_si128(_mm_cmpgt_epi32(remainder, lastCoordinate), sizes));
+    return _mm_max_epi32(_mm_min_epi32(remainder, lastCoordinate), zero);
+}
+
+SIMD_TARGET("avx2")
+static __m256i wrapTextureCoordinateAVX2(__m256i coordinate, int size) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i sizes = _mm256_set1_epi32(size);
+    const __m256i lastCoordinate = _mm256_set1_epi32(size - 1);
+
+    coordinate = _mm256_max_epi32(_mm256_abs_epi32(coordinate), zero);
+    const __m256 quotientF = _mm256_mul_ps(_mm256_cvtepi32_ps(coordinate), _mm256_set1_ps(1.f / (float) size));
+    const __m256i quotient = _mm256_cvttps_epi32(quotientF);
+    __m256i remainder = _mm256_sub_epi32(coordinate, _mm256_mullo_epi32(quotient, sizes));
+    remainder = _mm256_add_epi32(remainder, _mm256_and_si256(_mm256_cmpgt_epi32(zero, remainder), sizes));
+    remainder = _mm256_sub_epi32(remainder, _mm256_and_si256(_mm256_cmpgt_epi32(remainder, lastCoordinate), sizes));
+    return _mm256_max_epi32(_mm256_min_epi32(remainder, lastCoordinate), zero);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE4.1, 4 pixels at a time. There are no masked loads or stores, so the
+// vector loop only runs while all 4 lanes are inside the span, it blends the
+// new pixels with the old ones, and the last few pixels go through the
+// scalar kernel.
+///////////////////////////////////////////////////////////////////////////////
+SIMD_TARGET("sse4.1")
+static void drawFilledSpanSSE41(const Span *span) {
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128 lanesF = _mm_cvtepi32_ps(lanes);
+    const __m128i minusOne = _mm_set1_epi32(-1);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128i color = _mm_set1_epi32((int) span->color);
+
+    __m128i edge0 = _mm_add_epi32(_mm_set1_epi32(span->edge[0]), _mm_mullo_epi32(lanes, _mm_set1_epi32(span->edgeStepX[0])));
+    __m128i edge1 = _mm_add_epi32(_mm_set1_epi32(span->edge[1]), _mm_mullo_epi32(lanes, _mm_set1_epi32(span->edgeStepX[1])));
+    __m128i edge2 = _mm_add_epi32(_mm_set1_epi32(span->edge[2]), _mm_mullo_epi32(lanes, _mm_set1_epi32(span->edgeStepX[2])));
+    const __m128i edgeStep0 = _mm_set1_epi32(span->edgeStepX[0] * 4);
+    const __m128i edgeStep1 = _mm_set1_epi32(span->edgeStepX[1] * 4);
+    const __m128i edgeStep2 = _mm_set1_epi32(span->edgeStepX[2] * 4);
+
+    __m128 reciprocalW = _mm_add_ps(_mm_set1_ps(span->reciprocalW), _mm_mul_ps(lanesF, _mm_set1_ps(span->reciprocalWStepX)));
+    const __m128 reciprocalWStep = _mm_set1_ps(span->reciprocalWStepX * 4);
+
+    int numCovered = 0;
+    int numPassed = 0;
+    int x = span->minX;
+    for (; x + 3 <= span->maxX; x += 4) {
+        const __m128i edges = _mm_or_si128(_mm_or_si128(edge0, edge1), edge2);
+        const __m128i covered = _mm_cmpgt_epi32(edges, minusOne);
+        const int coveredMask = _mm_movemask_ps(_mm_castsi128_ps(covered));
+        if (coveredMask != 0) {
+            const __m128 depth = _mm_sub_ps(one, reciprocalW);
+            const __m128 oldDepth = _mm_loadu_ps(span->zRow + x);
+            const __m128 pass = _mm_and_ps(_mm_castsi128_ps(covered), _mm_cmplt_ps(depth, oldDepth));
+            const int passMask = _mm_movemask_ps(pass);
+            numCovered += countMaskLanes(coveredMask);
+            numPassed += countMaskLanes(passMask);
+            if (passMask != 0) {
+                const __m128i oldColor = _mm_loadu_si128((const __m128i *) (span->colorRow + x));
+                _mm_storeu_si128(
+                    (__m128i *) (span->colorRow + x), _mm_blendv_epi8(oldColor, color, _mm_castps_si128(pass))
+                );
+                _mm_storeu_ps(span->zRow + x, _mm_blendv_ps(oldDepth, depth, pass));
+            }
+        }
+        edge0 = _mm_add_epi32(edge0, edgeStep0);
+        edge1 = _mm_add_epi32(edge1, edgeStep1);
+        edge2 = _mm_add_epi32(edge2, edgeStep2);
+        reciprocalW = _mm_add_ps(reciprocalW, reciprocalWStep);
+    }
+    span->stats->depthPassed += numPassed;
+    span->stats->depthFailed += numCovered - numPassed;
+    drawSpanTailScalar(span, x, drawFilledSpanScalar);
+}
+
+SIMD_TARGET("sse4.1")
+static void drawTexturedSpanSSE41(const Span *span) {
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128 lanesF = _mm_cvtepi32_ps(lanes);
+    const __m128i minusOne = _mm_set1_epi32(-1);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 textureWidthF = _mm_set1_ps((float) span->textureWidth);
+    const __m128 textureHeightF = _mm_set1_ps((float) span->textureHeight);
+    const __m128i textureWidth = _mm_set1_epi32(span->textureWidth);
+
+    __m128i edge0 = _mm_add_epi32(_mm_set1_epi32(span->edge[0]), _mm_mullo_epi32(lanes, _mm_set1_epi32(span->edgeStepX[0])));
+    __m128i edge1 = _mm_add_epi32(_mm_set1_epi32(span->edge[1]), _mm_mullo_epi32(lanes, _mm_set1_epi32(span->edgeStepX[1])));
+    __m128i edge2 = _mm_add_epi32(_mm_set1_epi32(span->edge[2]), _mm_mullo_epi32(lanes, _mm_set1_epi32(span->edgeStepX[2])));
+    const __m128i edgeStep0 = _mm_set1_epi32(span->edgeStepX[0] * 4);
+    const __m128i edgeStep1 = _mm_set1_epi32(span->edgeStepX[1] * 4);
+    const __m128i edgeStep2 = _mm_set1_epi32(span->edgeStepX[2] * 4);
+
+    __m128 reciprocalW = _mm_add_ps(_mm_set1_ps(span->reciprocalW), _mm_mul_ps(lanesF, _mm_set1_ps(span->reciprocalWStepX)));
+    __m128 uOverW = _mm_add_ps(_mm_set1_ps(span->uOverW), _mm_mul_ps(lanesF, _mm_set1_ps(span->uOverWStepX)));
+    __m128 vOverW = _mm_add_ps(_mm_set1_ps(span->vOverW), _mm_mul_ps(lanesF, _mm_set1_ps(span->vOverWStepX)));
+    const __m128 reciprocalWStep = _mm_set1_ps(span->reciprocalWStepX * 4);
+    const __m128 uOverWStep = _mm_set1_ps(span->uOverWStepX * 4);
+    const __m128 vOverWStep = _mm_set1_ps(span->vOverWStepX * 4);
+
+    int numCovered = 0;
+    int numPassed = 0;
+    int numFetched = 0;
+    int x = span->minX;
+    for (; x + 3 <= span->maxX; x += 4) {
+        const __m128i edges = _mm_or_si128(_mm_or_si128(edge0, edge1), edge2);
+        const __m128i covered = _mm_cmpgt_epi32(edges, minusOne);
+        const int coveredMask = _mm_movemask_ps(_mm_castsi128_ps(covered));
+        if (coveredMask != 0) {
+            const __m128 depth = _mm_sub_ps(one, reciprocalW);
+            const __m128 oldDepth = _mm_loadu_ps(span->zRow + x);
+            const __m128 pass = _mm_and_ps(_mm_castsi128_ps(covered), _mm_cmplt_ps(depth, oldDepth));
+            const int passMask = _mm_movemask_ps(pass);
+            numCovered += countMaskLanes(coveredMask);
+            numPassed += countMaskLanes(passMask);
+            if (passMask != 0) {
+                const __m128 w = _mm_div_ps(one, reciprocalW);
+                const __m128i textureX = _mm_cvttps_epi32(_mm_mul_ps(_mm_mul_ps(uOverW, w), textureWidthF));
+                const __m128i textureY = _mm_cvttps_epi32(_mm_mul_ps(_mm_mul_ps(vOverW, w), textureHeightF));
+                const __m128i texelIndex = _mm_add_epi32(
+                    _mm_mullo_epi32(wrapTextureCoordinateSSE41(textureY, span->textureHeight), textureWidth),
+                    wrapTextureCoordinateSSE41(textureX, span->textureWidth)
+                );
+
+                // no gather before AVX2, fetch the 4 texels one by one. Only the lanes
+                // that pass are counted, as in the scalar and AVX2 kernels
+                numFetched += countMaskLanes(passMask);
+                const __m128i texels = _mm_setr_epi32(
+                    (int) span->texture[_mm_extract_epi32(texelIndex, 0)],
+                    (int) span->texture[_mm_extract_epi32(texelIndex, 1)],
+                    (int) span->texture[_mm_extract_epi32(texelIndex, 2)],
+                    (int) span->texture[_mm_extract_epi32(texelIndex, 3)]
+                );
+                const __m128i oldColor = _mm_loadu_si128((const __m128i *) (span->colorRow + x));
+                _mm_storeu_si128(
+                    (__m128i *) (span->colorRow + x), _mm_blendv_epi8(oldColor, texels, _mm_castps_si128(pass))
+                );
+                _mm_storeu_ps(span->zRow + x, _mm_blendv_ps(oldDepth, depth, pass));
+            }
+        }
+        edge0 = _mm_add_epi32(edge0, edgeStep0);
+        edge1 = _mm_add_epi32(edge1, edgeStep1);
+        edge2 = _mm_add_epi32(edge2, edgeStep2);
+        reciprocalW = _mm_add_ps(reciprocalW, reciprocalWStep);
+        uOverW = _mm_add_ps(uOverW, uOverWStep);
+        vOverW = _mm_add_ps(vOverW, vOverWStep);
+    }
+    span->stats->depthPassed += numPassed;
+    span->stats->depthFailed += numCovered - numPassed;
+    span->stats->texelsFetched += numFetched;
+    drawSpanTailScalar(span, x, drawTexturedSpanScalar);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2, 8 pixels at a time. Masked loads and stores let the last iteration
+// run past the end of the span without touching the pixels after it.
+///////////////////////////////////////////////////////////////////////////////
+SIMD_TARGET("avx2")
+static void drawFilledSpanAVX2(const Span *span) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 lanesF = _mm256_cvtepi32_ps(lanes);
+    const __m256i minusOne = _mm256_set1_epi32(-1);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256i color = _mm256_set1_epi32((int) span->color);
+
+    __m256i edge0 = _mm256_add_epi32(_mm256_set1_epi32(span->edge[0]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(span->edgeStepX[0])));
+    __m256i edge1 = _mm256_add_epi32(_mm256_set1_epi32(span->edge[1]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(span->edgeStepX[1])));
+    __m256i edge2 = _mm256_add_epi32(_mm256_set1_epi32(span->edge[2]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(span->edgeStepX[2])));
+    const __m256i edgeStep0 = _mm256_set1_epi32(span->edgeStepX[0] * 8);
+    const __m256i edgeStep1 = _mm256_set1_epi32(span->edgeStepX[1] * 8);
+    const __m256i edgeStep2 = _mm256_set1_epi32(span->edgeStepX[2] * 8);
+
+    __m256 reciprocalW = _mm256_add_ps(_mm256_set1_ps(span->reciprocalW), _mm256_mul_ps(lanesF, _mm256_set1_ps(span->reciprocalWStepX)));
+    const __m256 reciprocalWStep = _mm256_set1_ps(span->reciprocalWStepX * 8);
+
+    int numCovered = 0;
+    int numPassed = 0;
+    for (int x = span->minX; x <= span->maxX; x += 8) {
+        // lanes past the end of the span are never covered
+        const __m256i inSpan = _mm256_cmpgt_epi32(_mm256_set1_epi32(span->maxX - x + 1), lanes);
+        const __m256i edges = _mm256_or_si256(_mm256_or_si256(edge0, edge1), edge2);
+        const __m256i covered = _mm256_and_si256(inSpan, _mm256_cmpgt_epi32(edges, minusOne));
+        if (!_mm256_testz_si256(covered, covered)) {
+            const __m256 depth = _mm256_sub_ps(one, reciprocalW);
+            const __m256 oldDepth = _mm256_maskload_ps(span->zRow + x, covered);
+            const __m256i pass = _mm256_and_si256(
+                covered, _mm256_castps_si256(_mm256_cmp_ps(depth, oldDepth, _CMP_LT_OQ))
+            );
+            const int passMask = _mm256_movemask_ps(_mm256_castsi256_ps(pass));
+            numCovered += countMaskLanes(_mm256_movemask_ps(_mm256_castsi256_ps(covered)));
+            numPassed += countMaskLanes(passMask);
+            _mm256_maskstore_epi32((int *) (span->colorRow + x), pass, color);
+            _mm256_maskstore_ps(span->zRow + x, pass, depth);
+        }
+        edge0 = _mm256_add_epi32(edge0, edgeStep0);
+        edge1 = _mm256_add_epi32(edge1, edgeStep1);
+        edge2 = _mm256_add_epi32(edge2, edgeStep2);
+        reciprocalW = _mm256_add_ps(reciprocalW, reciprocalWStep);
+    }
+    span->stats->depthPassed += numPassed;
+    span->stats->depthFailed += numCovered - numPassed;
+}
+
+SIMD_TARGET("avx2")
+static void drawTexturedSpanAVX2(const Span *span) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 lanesF = _mm256_cvtepi32_ps(lanes);
+    const __m256i minusOne = _mm256_set1_epi32(-1);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 textureWidthF = _mm256_set1_ps((float) span->textureWidth);
+    const __m256 textureHeightF = _mm256_set1_ps((float) span->textureHeight);
+    const __m256i textureWidth = _mm256_set1_epi32(span->textureWidth);
+
+    __m256i edge0 = _mm256_add_epi32(_mm256_set1_epi32(span->edge[0]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(span->edgeStepX[0])));
+    __m256i edge1 = _mm256_add_epi32(_mm256_set1_epi32(span->edge[1]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(span->edgeStepX[1])));
+    __m256i edge2 = _mm256_add_epi32(_mm256_set1_epi32(span->edge[2]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(span->edgeStepX[2])));
+    const __m256i edgeStep0 = _mm256_set1_epi32(span->edgeStepX[0] * 8);
+    const __m256i edgeStep1 = _mm256_set1_epi32(span->edgeStepX[1] * 8);
+    const __m256i edgeStep2 = _mm256_set1_epi32(span->edgeStepX[2] * 8);
+
+    __m256 reciprocalW = _mm256_add_ps(_mm256_set1_ps(span->reciprocalW), _mm256_mul_ps(lanesF, _mm256_set1_ps(span->reciprocalWStepX)));
+    __m256 uOverW = _mm256_add_ps(_mm256_set1_ps(span->uOverW), _mm256_mul_ps(lanesF, _mm256_set1_ps(span->uOverWStepX)));
+    __m256 vOverW = _mm256_add_ps(_mm256_set1_ps(span->vOverW), _mm256_mul_ps(lanesF, _mm256_set1_ps(span->vOverWStepX)));
+    const __m256 reciprocalWStep = _mm256_set1_ps(span->reciprocalWStepX * 8);
+    const __m256 uOverWStep = _mm256_set1_ps(span->uOverWStepX * 8);
+    const __m256 vOverWStep = _mm256_set1_ps(span->vOverWStepX * 8);
+
+    int numCovered = 0;
+    int numPassed = 0;
+    for (int x = span->minX; x <= span->maxX; x += 8) {
+        const __m256i inSpan = _mm256_cmpgt_epi32(_mm256_set1_epi32(span->maxX - x + 1), lanes);
+        const __m256i edges = _mm256_or_si256(_mm256_or_si256(edge0, edge1), edge2);
+        const __m256i covered = _mm256_and_si256(inSpan, _mm256_cmpgt_epi32(edges, minusOne));
+        if (!_mm256_testz_si256(covered, covered)) {
+            const __m256 depth = _mm256_sub_ps(one, reciprocalW);
+            const __m256 oldDepth = _mm256_maskload_ps(span->zRow + x, covered);
+            const __m256i pass = _mm256_and_si256(
+                covered, _mm256_castps_si256(_mm256_cmp_ps(depth, oldDepth, _CMP_LT_OQ))
+            );
+            const int passMask = _mm256_movemask_ps(_mm256_castsi256_ps(pass));
+            numCovered += countMaskLanes(_mm256_movemask_ps(_mm256_castsi256_ps(covered)));
+            numPassed += countMaskLanes(passMask);
+            if (passMask != 0) {
+                const __m256 w = _mm256_div_ps(one, reciprocalW);
+                const __m256i textureX = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_mul_ps(uOverW, w), textureWidthF));
+                const __m256i textureY = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_mul_ps(vOverW, w), textureHeightF));
+                const __m256i texelIndex = _mm256_add_epi32(
+                    _mm256_mullo_epi32(wrapTextureCoordinateAVX2(textureY, span->textureHeight), textureWidth),
+                    wrapTextureCoordinateAVX2(textureX, span->textureWidth)
+                );
+                const __m256i texels = _mm256_mask_i32gather_epi32(
+                    _mm256_setzero_si256(), (const int *) span->texture, texelIndex, pass, 4
+                );
+                _mm256_maskstore_epi32((int *) (span->colorRow + x), pass, texels);
+                _mm256_maskstore_ps(span->zRow + x, pass, depth);
+            }
+        }
+        edge0 = _mm256_add_epi32(edge0, edgeStep0);
+        edge1 = _mm256_add_epi32(edge1, edgeStep1);
+        edge2 = _mm256_add_epi32(edge2, edgeStep2);
+        reciprocalW = _mm256_add_ps(reciprocalW, reciprocalWStep);
+        uOverW = _mm256_add_ps(uOverW, uOverWStep);
+        vOverW = _mm256_add_ps(vOverW, vOverWStep);
+    }
+    span->stats->depthPassed += numPassed;
+    span->stats->depthFailed += numCovered - numPassed;
+    span->stats->texelsFetched += numPassed;
+}
+
+#endif // SIMD_X86
+
+SpanFunction drawFilledSpan = drawFilledSpanScalar;
+SpanFunction drawTexturedSpan = drawTexturedSpanScalar;
+static const char *spanFunctionsName = "scalar";
+
+///////////////////////////////////////////////////////////////////////////////
+// Pick the widest kernels the CPU we are running on supports
+///////////////////////////////////////////////////////////////////////////////
+void initSpanFunctions(void) {
+    drawFilledSpan = drawFilledSpanScalar;
+    drawTexturedSpan = drawTexturedSpanScalar;
+    spanFunctionsName = "scalar";
+#if SIMD_X86
+    if (SDL_HasAVX2()) {
+        drawFilledSpan = drawFilledSpanAVX2;
+        drawTexturedSpan = drawTexturedSpanAVX2;
+        spanFunctionsName = "avx2";
+    } else if (SDL_HasSSE41()) {
+        drawFilledSpan = drawFilledSpanSSE41;
+        drawTexturedSpan = drawTexturedSpanSSE41;
+        spanFunctionsName = "sse4.1";
+    }
+#endif
+}
+
+const char *getSpanFunctionsName(void) {
+    return spanFunctionsName;
+}
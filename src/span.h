@@ -0,0 +1,38 @@
+#ifndef SDL2_SOFTWARE_RENDERER_SPAN_H
+#define SDL2_SOFTWARE_RENDERER_SPAN_H
+
+#include <stdint.h>
+
+#include "stats.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// One scanline of a triangle, from minX to maxX inclusive. Everything is
+// given at x = minX together with its change for every pixel to the right.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    int minX, maxX;
+    int edge[3];        // biased edge functions, the pixel is covered when none is negative
+    int edgeStepX[3];
+    float reciprocalW, reciprocalWStepX;
+    float uOverW, uOverWStepX;
+    float vOverW, vOverWStepX;
+    uint32_t color;
+    const uint32_t *texture;
+    int textureWidth, textureHeight;
+    uint32_t *colorRow;  // the scanline in the color buffer, indexed by x
+    float *zRow;         // the scanline in the z-buffer, indexed by x
+    PipelineStats *stats;  // gets the depth test and texel counts of the span
+} Span;
+
+typedef void (*SpanFunction)(const Span *span);
+
+extern SpanFunction drawFilledSpan;
+extern SpanFunction drawTexturedSpan;
+
+// colorRow holds shading counts instead of colors, see shadeOverdrawHeatmap
+void drawOverdrawSpan(const Span *span);
+
+void initSpanFunctions(void);
+const char *getSpanFunctionsName(void);
+
+#endif //SDL2_SOFTWARE_RENDERER_SPAN_H
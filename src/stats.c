@@ -0,0 +1,49 @@
+#include "stats.h"
+
+#include <string.h>
+
+void clearPipelineStats(PipelineStats *stats) {
+    memset(stats, 0, sizeof(PipelineStats));
+}
+
+void addPipelineStats(PipelineStats *total, const PipelineStats *stats) {
+    total->frames += stats->frames;
+    total->pixels += stats->pixels;
+    total->facesSubmitted += stats->facesSubmitted;
+    total->facesRejected += stats->facesRejected;
+    total->facesCulled += stats->facesCulled;
+    total->facesClipped += stats->facesClipped;
+    total->facesClippedAway += stats->facesClippedAway;
+    total->trianglesFromClipping += stats->trianglesFromClipping;
+    total->trianglesQueued += stats->trianglesQueued;
+    total->trianglesDropped += stats->trianglesDropped;
+    total->depthPassed += stats->depthPassed;
+    total->depthFailed += stats->depthFailed;
+    total->texelsFetched += stats->texelsFetched;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Print the counts as averages per frame. Overdraw is how many times every
+// pixel of the frame buffer was covered by a triangle (the depth complexity)
+// and how many times it was written, 1 is the best a scene can do.
+///////////////////////////////////////////////////////////////////////////////
+void printPipelineStats(FILE *file, const char *title, const PipelineStats *stats) {
+    const double frames = stats->frames > 0 ? stats->frames : 1;
+    const double pixels = stats->pixels > 0 ? (double) stats->pixels : 1;
+    fprintf(file, "%s, average of %d frames:\n", title, stats->frames);
+    fprintf(file, "  faces submitted         %12.1f\n", stats->facesSubmitted / frames);
+    fprintf(file, "  faces rejected          %12.1f\n", stats->facesRejected / frames);
+    fprintf(file, "  faces backface culled   %12.1f\n", stats->facesCulled / frames);
+    fprintf(file, "  faces clipped           %12.1f\n", stats->facesClipped / frames);
+    fprintf(file, "  faces clipped away      %12.1f\n", stats->facesClippedAway / frames);
+    fprintf(file, "  triangles from clipping %12.1f\n", stats->trianglesFromClipping / frames);
+    fprintf(file, "  triangles queued        %12.1f\n", stats->trianglesQueued / frames);
+    fprintf(file, "  triangles dropped       %12.1f\n", stats->trianglesDropped / frames);
+    fprintf(file, "  depth test passed       %12.1f\n", stats->depthPassed / frames);
+    fprintf(file, "  depth test failed       %12.1f\n", stats->depthFailed / frames);
+    fprintf(file, "  texels fetched          %12.1f\n", stats->texelsFetched / frames);
+    fprintf(
+        file, "  overdraw                %12.2f covered, %.2f written per pixel\n",
+        (double) (stats->depthPassed + stats->depthFailed) / pixels, (double) stats->depthPassed / pixels
+    );
+}
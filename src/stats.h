@@ -0,0 +1,34 @@
+#ifndef SDL2_SOFTWARE_RENDERER_STATS_H
+#define SDL2_SOFTWARE_RENDERER_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// What the pipeline did, for one frame or summed up over many. The geometry
+// counts are per face of the mesh, the rasterization counts per pixel that a
+// triangle covers.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    int frames;
+    uint64_t pixels;                 // frame buffer pixels, for the overdraw
+
+    uint64_t facesSubmitted;
+    uint64_t facesRejected;          // outside of one frustum plane, by the outcodes
+    uint64_t facesCulled;            // facing away from the camera
+    uint64_t facesClipped;           // went through clipPolygon
+    uint64_t facesClippedAway;       // nothing left of them after clipPolygon
+    uint64_t trianglesFromClipping;  // the triangles the clipped faces were split into
+    uint64_t trianglesQueued;
+    uint64_t trianglesDropped;       // no memory left in the render queue
+
+    uint64_t depthPassed;
+    uint64_t depthFailed;
+    uint64_t texelsFetched;
+} PipelineStats;
+
+void clearPipelineStats(PipelineStats *stats);
+void addPipelineStats(PipelineStats *total, const PipelineStats *stats);
+void printPipelineStats(FILE *file, const char *title, const PipelineStats *stats);
+
+#endif //SDL2_SOFTWARE_RENDERER_STATS_H
@@ -3,31 +3,86 @@
 //
 
 #include "texture.h"
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <SDL2/SDL.h>
 #include "upng.h"
 
 
-upng_t *pngTexture = NULL;
 uint32_t *meshTexture = NULL;
 int textureWidth = 64;
 int textureHeight = 64;
 
-void loadPNGTextureData(const char *fileName) {
-    pngTexture = upng_new_from_file(fileName);
-    if (pngTexture == NULL) {
-        printf("Error loading texture: %s\n", (upng_get_error(pngTexture)));
-        return;
+// shown while the texture of a mesh is loading, or when it has none
+#define PLACEHOLDER_TEXTURE_SIZE 16
+static uint32_t placeholderTexture[PLACEHOLDER_TEXTURE_SIZE * PLACEHOLDER_TEXTURE_SIZE];
+
+// the image meshTexture points into, no pixels for the placeholder
+static TextureImage currentTexture = {.pixels = NULL, .width = 0, .height = 0};
+
+// the PNG is decoded straight into the pixels, which the color buffer takes
+// as they are, and the upng object with the file in it is gone afterwards
+bool decodePNGTexture(const char *fileName, TextureImage *image) {
+    upng_t *png = upng_new_from_file(fileName);
+    if (png == NULL || upng_header(png) != UPNG_EOK) {
+        printf("Error loading texture: %s\n", fileName);
+        if (png) {
+            upng_free(png);
+        }
+        return false;
     }
 
-    upng_decode(pngTexture);
-    if (upng_get_error(pngTexture) != UPNG_EOK) {
-        printf("Error loading texture: %s\n", upng_get_error(pngTexture));
+    const int width = (int) upng_get_width(png);
+    const int height = (int) upng_get_height(png);
+    uint32_t *pixels = SDL_SIMDAlloc(sizeof(uint32_t) * width * height);
+    const upng_error error = pixels ? upng_decode_rgba32(png, (unsigned char *) pixels) : UPNG_ENOMEM;
+    upng_free(png);
+    if (error != UPNG_EOK) {
+        printf("Error loading texture: %s (upng error %d)\n", fileName, error);
+        SDL_SIMDFree(pixels);
+        return false;
+    }
+
+    image->pixels = pixels;
+    image->width = width;
+    image->height = height;
+    return true;
+}
+
+void freeTextureImage(TextureImage *image) {
+    SDL_SIMDFree(image->pixels);
+    image->pixels = NULL;
+    image->width = 0;
+    image->height = 0;
+}
+
+void setMeshTexture(TextureImage *image) {
+    freeTextureImage(&currentTexture);
+    if (image && image->pixels) {
+        currentTexture = *image;
+        textureWidth = image->width;
+        textureHeight = image->height;
+        meshTexture = image->pixels;
         return;
     }
-    textureWidth = upng_get_width(pngTexture);
-    textureHeight = upng_get_height(pngTexture);
-    meshTexture = (uint32_t *) upng_get_buffer(pngTexture);
+
+    for (int y = 0; y < PLACEHOLDER_TEXTURE_SIZE; y++) {
+        for (int x = 0; x < PLACEHOLDER_TEXTURE_SIZE; x++) {
+            const bool isDark = ((x / 4) + (y / 4)) % 2 == 0;
+            placeholderTexture[y * PLACEHOLDER_TEXTURE_SIZE + x] = isDark ? 0xFF404040 : 0xFFC0C0C0;
+        }
+    }
+    textureWidth = PLACEHOLDER_TEXTURE_SIZE;
+    textureHeight = PLACEHOLDER_TEXTURE_SIZE;
+    meshTexture = placeholderTexture;
+}
+
+void loadPNGTextureData(const char *fileName) {
+    TextureImage image;
+    if (decodePNGTexture(fileName, &image)) {
+        setMeshTexture(&image);
+    }
 }
 
 Texture2 texture2_clone(Texture2 *t) {
@@ -5,24 +5,39 @@
 #ifndef SDL2_SOFTWARE_RENDERER_TEXTURE_H
 #define SDL2_SOFTWARE_RENDERER_TEXTURE_H
 
+#include <stdbool.h>
 #include <stdint.h>
-#include "upng.h"
 
 typedef struct {
     float u;
     float v;
 } Texture2;
 
+// a decoded texture, pixels in the SDL_PIXELFORMAT_RGBA32 byte order of the
+// color buffer, from SDL_SIMDAlloc; NULL pixels for no texture
+typedef struct {
+    uint32_t *pixels;
+    int width;
+    int height;
+} TextureImage;
+
 extern int textureWidth;
 extern int textureHeight;
 
-extern upng_t* pngTexture;
 extern uint32_t* meshTexture;
 
 extern const uint8_t REDBRICK_TEXTURE[];
 
 void loadPNGTextureData(const char *fileName);
 
+// decode a PNG file without touching the mesh texture, false on errors
+bool decodePNGTexture(const char *fileName, TextureImage *image);
+void freeTextureImage(TextureImage *image);
+// make image the mesh texture, which takes over its pixels, and free the
+// previous one; NULL or an image without pixels sets the placeholder
+// checkerboard
+void setMeshTexture(TextureImage *image);
+
 Texture2 texture2_clone(Texture2 *t);
 
 #endif //SDL2_SOFTWARE_RENDERER_TEXTURE_H
@@ -0,0 +1,163 @@
+#include "tiles.h"
+
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+
+#include "display.h"
+#include "job.h"
+#include "profile.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Tile-binned rasterization
+///////////////////////////////////////////////////////////////////////////////
+// The screen is split in TILE_SIZE x TILE_SIZE tiles. Every frame we first
+// bin the projected triangles: each triangle index is appended to the list of
+// every tile its bounding box touches. Then every tile becomes a job of the
+// job system, which rasterizes the tile's triangles clipped to the tile rect.
+//
+//   +------+------+------+
+//   |  0   |  1 /\|  2   |    triangle lands in the bins of tiles 1, 2, 4, 5
+//   +------+---/--\------+
+//   |  3   |  4/____\ 5  |
+//   +------+------+------+
+//
+// A tile is only ever touched by the thread that runs its job, and tiles never
+// overlap, so colorBuffer and zBuffer are written without any locking. Bins
+// keep the triangles in submission order, so the result is the same as
+// rasterizing everything on a single thread.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    int *triangleIndices;
+    int numTriangles;
+    int capacity;
+    PipelineStats stats;  // only written by the thread rasterizing the tile
+} TileBin;
+
+static TileBin *tileBins = NULL;
+static int numTilesX = 0;
+static int numTilesY = 0;
+
+// the work description of the current frame, read-only while the jobs run
+static const ScreenTriangle *frameTriangles = NULL;
+static const uint32_t *frameTexture = NULL;
+
+static void binPush(TileBin *bin, int triangleIndex) {
+    if (bin->numTriangles == bin->capacity) {
+        bin->capacity = bin->capacity == 0 ? 64 : bin->capacity * 2;
+        bin->triangleIndices = realloc(bin->triangleIndices, sizeof(int) * bin->capacity);
+    }
+    bin->triangleIndices[bin->numTriangles++] = triangleIndex;
+}
+
+static void resizeTileBins(void) {
+    const int tilesX = (getWindowWidth() + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (getWindowHeight() + TILE_SIZE - 1) / TILE_SIZE;
+    if (tilesX == numTilesX && tilesY == numTilesY) {
+        return;
+    }
+
+    for (int i = 0; i < numTilesX * numTilesY; i++) {
+        free(tileBins[i].triangleIndices);
+    }
+    free(tileBins);
+    numTilesX = tilesX;
+    numTilesY = tilesY;
+    tileBins = calloc(numTilesX * numTilesY, sizeof(TileBin));
+}
+
+static void binTriangles(const ScreenTriangle *triangles, int numTriangles) {
+    PROFILE_BEGIN("bin triangles");
+    resizeTileBins();
+    for (int i = 0; i < numTilesX * numTilesY; i++) {
+        tileBins[i].numTriangles = 0;
+        clearPipelineStats(&tileBins[i].stats);
+    }
+
+    const int maxX = getWindowWidth() - 1;
+    const int maxY = getWindowHeight() - 1;
+    for (int i = 0; i < numTriangles; i++) {
+        const ScreenVertex *vertices = triangles[i].vertices;
+
+        const int x0 = vertices[0].x, y0 = vertices[0].y;
+        const int x1 = vertices[1].x, y1 = vertices[1].y;
+        const int x2 = vertices[2].x, y2 = vertices[2].y;
+
+        int minX = SDL_min(x0, SDL_min(x1, x2));
+        int minY = SDL_min(y0, SDL_min(y1, y2));
+        int maxXTriangle = SDL_max(x0, SDL_max(x1, x2));
+        int maxYTriangle = SDL_max(y0, SDL_max(y1, y2));
+        if (maxXTriangle < 0 || maxYTriangle < 0 || minX > maxX || minY > maxY) {
+            continue;
+        }
+        minX = SDL_max(minX, 0);
+        minY = SDL_max(minY, 0);
+        maxXTriangle = SDL_min(maxXTriangle, maxX);
+        maxYTriangle = SDL_min(maxYTriangle, maxY);
+
+        for (int tileY = minY / TILE_SIZE; tileY <= maxYTriangle / TILE_SIZE; tileY++) {
+            for (int tileX = minX / TILE_SIZE; tileX <= maxXTriangle / TILE_SIZE; tileX++) {
+                binPush(&tileBins[tileY * numTilesX + tileX], i);
+            }
+        }
+    }
+    PROFILE_END();
+}
+
+static void rasterizeTile(void *data, int tileIndex) {
+    (void) data;
+    TileBin *bin = &tileBins[tileIndex];
+    if (bin->numTriangles == 0) {
+        return;
+    }
+
+    PROFILE_BEGIN("tile");
+    const int tileX = tileIndex % numTilesX;
+    const int tileY = tileIndex / numTilesX;
+    const ClipRect tileRect = {
+        .minX = tileX * TILE_SIZE,
+        .minY = tileY * TILE_SIZE,
+        .maxX = SDL_min((tileX + 1) * TILE_SIZE, getWindowWidth()) - 1,
+        .maxY = SDL_min((tileY + 1) * TILE_SIZE, getWindowHeight()) - 1,
+    };
+
+    for (int i = 0; i < bin->numTriangles; i++) {
+        const ScreenTriangle *triangle = &frameTriangles[bin->triangleIndices[i]];
+
+        if (shouldRenderFilledTriangle()) {
+            drawFilledTriangle(triangle, tileRect, &bin->stats);
+        }
+
+        if (shouldRenderTexturedTriangle()) {
+            drawTexturedTriangle(triangle, frameTexture, tileRect, &bin->stats);
+        }
+
+        if (shouldRenderOverdraw()) {
+            drawOverdrawTriangle(triangle, tileRect, &bin->stats);
+        }
+    }
+    PROFILE_END();
+}
+
+void destroyTileRenderer(void) {
+    for (int i = 0; i < numTilesX * numTilesY; i++) {
+        free(tileBins[i].triangleIndices);
+    }
+    free(tileBins);
+    tileBins = NULL;
+    numTilesX = 0;
+    numTilesY = 0;
+}
+
+void renderTrianglesInTiles(
+    const ScreenTriangle *triangles, int numTriangles, const uint32_t *texture, PipelineStats *stats
+) {
+    binTriangles(triangles, numTriangles);
+
+    frameTriangles = triangles;
+    frameTexture = texture;
+    runJobs(rasterizeTile, NULL, numTilesX * numTilesY);
+
+    for (int i = 0; i < numTilesX * numTilesY; i++) {
+        addPipelineStats(stats, &tileBins[i].stats);
+    }
+}
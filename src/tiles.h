@@ -0,0 +1,19 @@
+#ifndef SDL2_SOFTWARE_RENDERER_TILES_H
+#define SDL2_SOFTWARE_RENDERER_TILES_H
+
+#include <stdint.h>
+
+#include "stats.h"
+#include "triangle.h"
+
+#define TILE_SIZE 64
+
+// the tiles are rasterized by the job system, it has to be initialized
+void destroyTileRenderer(void);
+
+// the depth test and texel counts of all the tiles are added to stats
+void renderTrianglesInTiles(
+    const ScreenTriangle *triangles, int numTriangles, const uint32_t *texture, PipelineStats *stats
+);
+
+#endif //SDL2_SOFTWARE_RENDERER_TILES_H
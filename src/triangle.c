@@ -4,330 +4,292 @@
 
 #include "triangle.h"
 
+#include <math.h>
+#include <stdbool.h>
+
 #include "display.h"
-#include "swap.h"
+#include "span.h"
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Draw a filled triangle with the flat-top/flat-bottom method
-// We split the original triangle in two, half flat-bottom and half flat-top
+// Rasterize triangles with the half-space (edge function) method
 ///////////////////////////////////////////////////////////////////////////////
+// Every edge of the triangle splits the screen in two half-spaces. For the
+// edge going from A to B, the edge function
+//
+//     E(p) = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x)
+//
+// is the 2d cross product of AB and AP: positive on the inside of the edge,
+// zero on the edge and negative on the outside. A pixel is covered by the
+// triangle when it is inside all three edges.
+//
+//                  C
+//                 / \
+//      E(A,C)<0  /   \  E(C,B)<0
+//               /  P  \
+//              A-------B
+//                E(B,A)<0
 //
-//          (x0,y0)
-//            / \
-//           /   \
-//          /     \
-//         /       \
-//        /         \
-//   (x1,y1)------(Mx,My)
-//       \_           \
-//          \_         \
-//             \_       \
-//                \_     \
-//                   \    \
-//                     \_  \
-//                        \_\
-//                           \
-//                         (x2,y2)
+// E(p) is linear in x and y, so moving one pixel to the right always adds
+// (a.y - b.y) and moving one pixel down always adds (b.x - a.x). We evaluate
+// the three functions once at the corner of the bounding box and step them
+// with additions only, no per-pixel setup.
 //
+// The edge function opposite to a vertex divided by the area of the whole
+// triangle (the edge function of the third vertex) is also the barycentric
+// weight of that vertex, so the weights are stepped the same way.
 ///////////////////////////////////////////////////////////////////////////////
-void drawFilledTriangle(
-    int x0, int y0, float z0, float w0,
-    int x1, int y1, float z1, float w1,
-    int x2, int y2, float z2, float w2,
-    uint32_t color
-) {
-    // We need to sort the vertices by y-coordinate ascending (y0 < y1 < y2)
-    if (y0 > y1) {
-        intSwap(&y0, &y1);
-        intSwap(&x0, &x1);
-        floatSwap(&z0, &z1);
-        floatSwap(&w0, &w1);
-    }
-    if (y1 > y2) {
-        intSwap(&y1, &y2);
-        intSwap(&x1, &x2);
-        floatSwap(&z1, &z2);
-        floatSwap(&w1, &w2);
-    }
-    if (y0 > y1) {
-        intSwap(&y0, &y1);
-        intSwap(&x0, &x1);
-        floatSwap(&z0, &z1);
-        floatSwap(&w0, &w1);
-    }
+typedef struct {
+    int minX, minY, maxX, maxY;  // bounding box, clamped to the viewport
+    int edgeRow[3];              // biased edge functions at (minX, minY)
+    int edgeStepX[3];
+    int edgeStepY[3];
+    int edgeBias[3];
+    float inverseArea;
+} TriangleEdges;
 
-    // Create three vector points after we sort the vertices
-    Vec4 pointA = {x0, y0, z0, w0};
-    Vec4 pointB = {x1, y1, z1, w1};
-    Vec4 pointC = {x2, y2, z2, w2};
+///////////////////////////////////////////////////////////////////////////////
+// A value that is linear in screen space across a triangle, stored as its
+// value at the top-left corner of the bounding box plus its change per pixel
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    float value;
+    float stepX;
+    float stepY;
+} TriangleGradient;
+
+static int edgeFunction(Vec2 a, Vec2 b, Vec2 p) {
+    // the points are on whole pixels, doing the products with integers keeps
+    // the result exact for vertices far out in the guard band too, where a
+    // float would already round them
+    return (int) (b.x - a.x) * (int) (p.y - a.y) - (int) (b.y - a.y) * (int) (p.x - a.x);
+}
 
-    ///////////////////////////////////////////////////////
-    // Render the upper part of the triangle (flat-bottom)
-    ///////////////////////////////////////////////////////
-    float invSlope1 = 0;
-    float invSlope2 = 0;
+static Vec2 screenVertexPosition(const ScreenVertex *vertex) {
+    return (Vec2) {vertex->x, vertex->y};
+}
 
-    if (y1 - y0 != 0) {
-        invSlope1 = (float) (x1 - x0) / abs(y1 - y0);
+///////////////////////////////////////////////////////////////////////////////
+// Pack a projected point (in pixels) and its texture coordinates into the
+// ScreenVertex the rasterizer reads
+///////////////////////////////////////////////////////////////////////////////
+// The rasterizer has no sub-pixel precision, x and y are truncated to whole
+// pixels as they always were. The guard band keeps them well inside int16.
+// V is flipped here, once per vertex, to account for the inverted texture
+// coordinates where V grows downwards instead of upwards. u and v stay
+// floats, the fetch wraps them however many times the texture repeats.
+///////////////////////////////////////////////////////////////////////////////
+ScreenVertex packScreenVertex(Vec4 projectedPoint, Texture2 textCoord) {
+    return (ScreenVertex) {
+        .x = (int16_t) fminf(fmaxf(projectedPoint.x, INT16_MIN), INT16_MAX),
+        .y = (int16_t) fminf(fmaxf(projectedPoint.y, INT16_MIN), INT16_MAX),
+        .u = textCoord.u,
+        .v = 1.f - textCoord.v,
+        .reciprocalW = 1 / projectedPoint.w,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Setup the edges of the triangle ABC, returns false if nothing can be drawn.
+// The vertices B and C are swapped when the triangle winds the other way so
+// the inside of every edge is always positive.
+///////////////////////////////////////////////////////////////////////////////
+static bool setupTriangleEdges(
+    TriangleEdges *edges, ScreenVertex *vertexA, ScreenVertex *vertexB, ScreenVertex *vertexC, ClipRect clipRect
+) {
+    Vec2 a = screenVertexPosition(vertexA);
+    Vec2 b = screenVertexPosition(vertexB);
+    Vec2 c = screenVertexPosition(vertexC);
+
+    int area = edgeFunction(a, b, c);
+    if (area == 0) {
+        // degenerate triangle, it does not cover any pixel
+        return false;
     }
-    if (y2 - y0 != 0) {
-        invSlope2 = (float) (x2 - x0) / abs(y2 - y0);
+    if (area < 0) {
+        ScreenVertex tmp = *vertexB;
+        *vertexB = *vertexC;
+        *vertexC = tmp;
+        b = screenVertexPosition(vertexB);
+        c = screenVertexPosition(vertexC);
+        area = -area;
     }
 
-    if (y1 - y0 != 0) {
-        for (int y = y0; y <= y1; y++) {
-            int x_start = x1 + (y - y1) * invSlope1;
-            int x_end = x0 + (y - y0) * invSlope2;
-
-            if (x_end < x_start) {
-                intSwap(&x_start, &x_end); // swap if x_start is to the right of x_end
-            }
-
-            for (int x = x_start; x < x_end; x++) {
-                // Draw our pixel with a solid color
-                drawTrianglePixel(x, y, color, pointA, pointB, pointC);
-            }
-        }
+    edges->minX = (int) fminf(a.x, fminf(b.x, c.x));
+    edges->minY = (int) fminf(a.y, fminf(b.y, c.y));
+    edges->maxX = (int) fmaxf(a.x, fmaxf(b.x, c.x));
+    edges->maxY = (int) fmaxf(a.y, fmaxf(b.y, c.y));
+
+    // only walk the part of the bounding box that is inside the clip rect
+    if (edges->minX < clipRect.minX) edges->minX = clipRect.minX;
+    if (edges->minY < clipRect.minY) edges->minY = clipRect.minY;
+    if (edges->maxX > clipRect.maxX) edges->maxX = clipRect.maxX;
+    if (edges->maxY > clipRect.maxY) edges->maxY = clipRect.maxY;
+    if (edges->minX > edges->maxX || edges->minY > edges->maxY) {
+        return false;
     }
 
-    ///////////////////////////////////////////////////////
-    // Render the bottom part of the triangle (flat-top)
-    ///////////////////////////////////////////////////////
-    invSlope1 = 0;
-    invSlope2 = 0;
-
-    if (y2 - y1 != 0) invSlope1 = (float) (x2 - x1) / abs(y2 - y1);
-    if (y2 - y0 != 0) invSlope2 = (float) (x2 - x0) / abs(y2 - y0);
-
-    if (y2 - y1 != 0) {
-        for (int y = y1; y <= y2; y++) {
-            int xStart = x1 + (y - y1) * invSlope1;
-            int xEnd = x0 + (y - y0) * invSlope2;
-
-            if (xEnd < xStart) {
-                intSwap(&xStart, &xEnd); // swap if x_start is to the right of x_end
-            }
-
-            for (int x = xStart; x < xEnd; x++) {
-                // Draw our pixel with a solid color
-                drawTrianglePixel(x, y, color, pointA, pointB, pointC);
-            }
-        }
+    // edge 0 is opposite to A, edge 1 is opposite to B and edge 2 is opposite to C
+    const Vec2 from[3] = {b, c, a};
+    const Vec2 to[3] = {c, a, b};
+    const Vec2 corner = {edges->minX, edges->minY};
+    for (int i = 0; i < 3; i++) {
+        edges->edgeStepX[i] = (int) (from[i].y - to[i].y);
+        edges->edgeStepY[i] = (int) (to[i].x - from[i].x);
+
+        // top-left fill rule: pixels exactly on a shared edge belong to only one
+        // of the two triangles. Left edges go up, top edges are horizontal and
+        // go right, those keep their pixels. The rest lose them by biasing the
+        // edge function down by one.
+        const bool isLeftEdge = edges->edgeStepX[i] > 0;
+        const bool isTopEdge = edges->edgeStepX[i] == 0 && edges->edgeStepY[i] > 0;
+        edges->edgeBias[i] = (isLeftEdge || isTopEdge) ? 0 : -1;
+
+        edges->edgeRow[i] = edgeFunction(from[i], to[i], corner) + edges->edgeBias[i];
     }
+    edges->inverseArea = 1.0f / (float) area;
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Function to draw a solid pixel at position (x,y) using depth interpolation
+// Setup the screen-space gradient of an attribute with the values a, b and c
+// at the three vertices of the triangle
 ///////////////////////////////////////////////////////////////////////////////
-void drawTrianglePixel(
-    int x, int y, uint32_t color,
-    Vec4 pointA, Vec4 pointB, Vec4 pointC
-) {
-    // Create three vec2 to find the interpolation
-    Vec2 p = {x, y};
-    Vec2 a = vec2_fromVec4(pointA);
-    Vec2 b = vec2_fromVec4(pointB);
-    Vec2 c = vec2_fromVec4(pointC);
-
-    // Calculate the barycentric coordinates of our point 'p' inside the triangle
-    Vec3 weights = barycentricWeights(a, b, c, p);
-
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
-
-    // Interpolate the value of 1/w for the current pixel
-    float interpolated_reciprocal_w = (1 / pointA.w) * alpha + (1 / pointB.w) * beta + (1 / pointC.w) * gamma;
-
-    // Adjust 1/w so the pixels that are closer to the camera have smaller values
-    interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
-
-    // Only draw the pixel if the depth value is less than the one previously stored in the z-buffer
-    if (interpolated_reciprocal_w < getZBufferAt(x, y)) {
-        // Draw a pixel at position (x,y) with a solid color
-        drawPixel(x, y, color);
-
-        // Update the z-buffer value with the 1/w of this current pixel
-        updateZBuffer(x, y, interpolated_reciprocal_w);
+// After the perspective divide, 1/w, u/w and v/w are linear in screen space,
+// so each one is a plane: value(x, y) = value + stepX * dx + stepY * dy.
+// Weighting the edge gradients by the vertex values gives the plane once per
+// triangle. Every row starts from the plane and the pixels of the row only
+// have to add stepX.
+///////////////////////////////////////////////////////////////////////////////
+static TriangleGradient setupTriangleGradient(const TriangleEdges *edges, float a, float b, float c) {
+    const float values[3] = {a, b, c};
+    TriangleGradient gradient = {.value = 0, .stepX = 0, .stepY = 0};
+    for (int i = 0; i < 3; i++) {
+        const float weight = (float) (edges->edgeRow[i] - edges->edgeBias[i]) * edges->inverseArea;
+        const float weightStepX = (float) edges->edgeStepX[i] * edges->inverseArea;
+        const float weightStepY = (float) edges->edgeStepY[i] * edges->inverseArea;
+        gradient.value += weight * values[i];
+        gradient.stepX += weightStepX * values[i];
+        gradient.stepY += weightStepY * values[i];
     }
+    return gradient;
 }
 
+// the value of a gradient at the start of a row, computed from the top of the
+// bounding box every time so the error does not build up down tall triangles
+static float gradientRowValue(const TriangleGradient *gradient, int row) {
+    return gradient->value + gradient->stepY * (float) row;
+}
 
-void drawTexel(
-    int x, int y, const uint32_t *texture,
-    Vec4 pointA, Vec4 pointB, Vec4 pointC,
-    Texture2 vertexA_UV, Texture2 vertexB_UV, Texture2 vertexC_UV
-    //float u0, float v0, float u1, float v1, float u2, float v2
-) {
-    Vec2 pointP = {.x = x, .y = y};
-    Vec2 a = vec2_fromVec4(pointA);
-    Vec2 b = vec2_fromVec4(pointB);
-    Vec2 c = vec2_fromVec4(pointC);
-
-    Vec3 weights = barycentricWeights(a, b, c, pointP);
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
-
-    // perform the interpolation of all U/2 and V/w values using the barycentric weights and a factor of 1/w
-    float interpolatedU = ((vertexA_UV.u / pointA.w) * alpha) +
-                          ((vertexB_UV.u / pointB.w) * beta) +
-                          ((vertexC_UV.u / pointC.w) * gamma);
-    float interpolatedV = ((vertexA_UV.v / pointA.w) * alpha) +
-                          ((vertexB_UV.v / pointB.w) * beta) +
-                          ((vertexC_UV.v / pointC.w) * gamma);
-
-    // in a real project, we could pass this in so its not calculated on each iteration.
-    // This would speed it up quite a bit since division is _slow_.
-    float interpolatedReciprocalW = (1 / pointA.w) * alpha + (1 / pointB.w) * beta + (1 / pointC.w) * gamma;
-
-    interpolatedU /= interpolatedReciprocalW;
-    interpolatedV /= interpolatedReciprocalW;
-
-    // Map the UV coordinates to the texture
-
-    // The modulus is to wrap around the texture if it goes out of bounds, this
-    // is a bit of a hack, but it works for this demo.
-    int textureX = abs((int) (interpolatedU * textureWidth)) % textureWidth;
-    int textureY = abs((int) (interpolatedV * textureHeight)) % textureHeight;
-
-    uint32_t texelIndex = (textureY * textureWidth) + textureX;
-    // make sure we don't go out of bounds
-    if (texelIndex >= textureWidth * textureHeight) {
-        printf("Texel index out of bounds: %d\n", texelIndex);
-        return;
+///////////////////////////////////////////////////////////////////////////////
+// Fill the span of the current row with the edges and gradients at minX and
+// point it at the row in the color and z buffers
+///////////////////////////////////////////////////////////////////////////////
+static void beginSpan(Span *span, const TriangleEdges *edges) {
+    span->minX = edges->minX;
+    span->maxX = edges->maxX;
+    for (int i = 0; i < 3; i++) {
+        span->edge[i] = edges->edgeRow[i];
+        span->edgeStepX[i] = edges->edgeStepX[i];
     }
+    span->colorRow = getColorBuffer() + edges->minY * getColorBufferPitch();
+    span->zRow = getZBuffer() + edges->minY * getWindowWidth();
+}
 
-    // only draw the pixel if the depth value is less than the one previously stored
-    // in the z-buffer
-
-    // adjust 1/w so the pixels that are closer to the camera have smaller values
-    interpolatedReciprocalW = 1.f - interpolatedReciprocalW;
-    if (interpolatedReciprocalW < getZBufferAt(x, y)) {
-        drawPixel(x, y, texture[texelIndex]);
-
-        // update z-buffer with 1/w of this current pixel
-        updateZBuffer(x, y, interpolatedReciprocalW);
+static void nextSpan(Span *span, const TriangleEdges *edges) {
+    for (int i = 0; i < 3; i++) {
+        span->edge[i] += edges->edgeStepY[i];
     }
+    span->colorRow += getColorBufferPitch();
+    span->zRow += getWindowWidth();
 }
 
-void drawTexturedTriangle(
-    int x0, int y0, float z0, float w0, float u0, float v0,
-    int x1, int y1, float z1, float w1, float u1, float v1,
-    int x2, int y2, float z2, float w2, float u2, float v2,
-    uint32_t *texture
+// a triangle with only 1/w interpolated, drawn with one of the flat span kernels
+static void drawFlatTriangle(
+    const ScreenTriangle *triangle, ClipRect clipRect, PipelineStats *stats, SpanFunction drawSpan
 ) {
-    // sort the vertices by y-coordinates ascending (y0 < y1 < y2).
-    if (y0 > y1) {
-        intSwap(&y0, &y1);
-        intSwap(&x0, &x1);
-        floatSwap(&u0, &u1);
-        floatSwap(&v0, &v1);
-        floatSwap(&z0, &z1);
-        floatSwap(&w0, &w1);
-    }
-    if (y1 > y2) {
-        intSwap(&y1, &y2);
-        intSwap(&x1, &x2);
-        floatSwap(&u1, &u2);
-        floatSwap(&v1, &v2);
-        floatSwap(&z1, &z2);
-        floatSwap(&w1, &w2);
-    }
-    if (y0 > y1) {
-        intSwap(&y0, &y1);
-        intSwap(&x0, &x1);
-        floatSwap(&u0, &u1);
-        floatSwap(&v0, &v1);
-        floatSwap(&z0, &z1);
-        floatSwap(&w0, &w1);
-    }
+    ScreenVertex vertexA = triangle->vertices[0];
+    ScreenVertex vertexB = triangle->vertices[1];
+    ScreenVertex vertexC = triangle->vertices[2];
 
-    // flip the V component to account for inverted UV-coordinates; where
-    // V grows downwards instead of upwards.
-    v0 = 1.f - v0;
-    v1 = 1.f - v1;
-    v2 = 1.f - v2;
-
-    // create vector points after we sort the vertices
-    Vec4 pointA = {.x = x0, .y = y0, .z = z0, .w = w0};
-    Vec4 pointB = {.x = x1, .y = y1, .z = z1, .w = w1};
-    Vec4 pointC = {.x = x2, .y = y2, .z = z2, .w = w2};
-    Texture2 vertexA_UV = {.u = u0, .v = v0};
-    Texture2 vertexB_UV = {.u = u1, .v = v1};
-    Texture2 vertexC_UV = {.u = u2, .v = v2};
-
-    // fill up the top half of the triangle
-    float inverseSlope1 = 0;
-    float inverseSlope2 = 0;
-    if (y1 - y0 != 0) {
-        inverseSlope1 = (float) (x1 - x0) / (float) abs(y1 - y0);
-    }
-    if (y2 - y0 != 0) {
-        inverseSlope2 = (float) (x2 - x0) / (float) abs(y2 - y0);
-    }
-    if (y1 - y0 != 0) {
-        for (int y = y0; y < y1; y++) {
-            int xStart = x1 + (y - y1) * inverseSlope1;
-            int xEnd = x0 + (y - y0) * inverseSlope2;
-            if (xEnd < xStart) {
-                intSwap(&xStart, &xEnd);
-            }
-
-            for (int x = (int) xStart; x < (int) xEnd; x++) {
-                drawTexel(x, y, texture, pointA, pointB, pointC, vertexA_UV, vertexB_UV, vertexC_UV);
-            }
-        }
+    TriangleEdges edges;
+    if (!setupTriangleEdges(&edges, &vertexA, &vertexB, &vertexC, clipRect)) {
+        return;
     }
 
-    // fill up the bottom half of the triangle
-    inverseSlope1 = 0;
-    inverseSlope2 = 0;
-    if (y2 - y1 != 0) {
-        inverseSlope1 = (float) (x2 - x1) / (float) abs(y2 - y1);
-    }
-    if (y2 - y0 != 0) {
-        inverseSlope2 = (float) (x2 - x0) / (float) abs(y2 - y0);
-    }
-    if (y2 - y1 != 0) {
-        for (int y = y1; y < y2; y++) {
-            int xStart = x1 + (y - y1) * inverseSlope1;
-            int xEnd = x0 + (y - y0) * inverseSlope2;
-            if (xEnd < xStart) {
-                intSwap(&xStart, &xEnd);
-            }
-
-            for (int x = (int) xStart; x < (int) xEnd; x++) {
-                drawTexel(x, y, texture, pointA, pointB, pointC, vertexA_UV, vertexB_UV, vertexC_UV);
-            }
-        }
+    const TriangleGradient reciprocalW = setupTriangleGradient(
+        &edges, vertexA.reciprocalW, vertexB.reciprocalW, vertexC.reciprocalW
+    );
+
+    Span span = {
+        .reciprocalWStepX = reciprocalW.stepX,
+        .color = triangle->color,
+        .stats = stats,
+    };
+    beginSpan(&span, &edges);
+    for (int y = edges.minY; y <= edges.maxY; y++) {
+        span.reciprocalW = gradientRowValue(&reciprocalW, y - edges.minY);
+        drawSpan(&span);
+
+        nextSpan(&span, &edges);
     }
 }
 
-Vec3 barycentricWeights(Vec2 a, Vec2 b, Vec2 c, Vec2 p) {
-    Vec2 ac = vec2_sub(c, a);
-    Vec2 ab = vec2_sub(b, a);
-    Vec2 pc = vec2_sub(c, p);
-    Vec2 pb = vec2_sub(b, p);
-    Vec2 ap = vec2_sub(p, a);
-
-    // area of the full parallelogram (triangle ABC) using cross product
-    float areaParallelogramABC = ac.x * ab.y - ac.y * ab.x; // 2d cross product, weird right?
-
-    // alpha = area of the parallelogram (triangle PBC) / area of the full parallelogram (triangle ABC)
-    float alpha = (pc.x * pb.y - pc.y * pb.x) / areaParallelogramABC;
+void drawFilledTriangle(const ScreenTriangle *triangle, ClipRect clipRect, PipelineStats *stats) {
+    drawFlatTriangle(triangle, clipRect, stats, drawFilledSpan);
+}
 
-    // beta = area of the parallelogram (triangle PCA) / area of the full parallelogram (triangle ABC)
-    float beta = (ac.x * ap.y - ac.y * ap.x) / areaParallelogramABC;
+void drawOverdrawTriangle(const ScreenTriangle *triangle, ClipRect clipRect, PipelineStats *stats) {
+    drawFlatTriangle(triangle, clipRect, stats, drawOverdrawSpan);
+}
 
-    // gamma = area of the parallelogram (triangle PAB) / area of the full parallelogram (triangle ABC)
-    // float gamma = (ab.x * ap.y - ab.y * ap.x) / areaParallelogramABC;
+void drawTexturedTriangle(
+    const ScreenTriangle *triangle, const uint32_t *texture, ClipRect clipRect, PipelineStats *stats
+) {
+    ScreenVertex vertexA = triangle->vertices[0];
+    ScreenVertex vertexB = triangle->vertices[1];
+    ScreenVertex vertexC = triangle->vertices[2];
 
-    // gamma = 1 - alpha - beta
-    float gamma = 1.0f - alpha - beta;
+    TriangleEdges edges;
+    if (!setupTriangleEdges(&edges, &vertexA, &vertexB, &vertexC, clipRect)) {
+        return;
+    }
 
-    Vec3 result = {.x = alpha, .y = beta, .z = gamma};
-    return result;
+    // perspective correct interpolation: 1/w, u/w and v/w are the values that
+    // are linear in screen space, so those are the ones we step
+    const TriangleGradient reciprocalW = setupTriangleGradient(
+        &edges, vertexA.reciprocalW, vertexB.reciprocalW, vertexC.reciprocalW
+    );
+    const TriangleGradient uOverW = setupTriangleGradient(
+        &edges,
+        vertexA.u * vertexA.reciprocalW,
+        vertexB.u * vertexB.reciprocalW,
+        vertexC.u * vertexC.reciprocalW
+    );
+    const TriangleGradient vOverW = setupTriangleGradient(
+        &edges,
+        vertexA.v * vertexA.reciprocalW,
+        vertexB.v * vertexB.reciprocalW,
+        vertexC.v * vertexC.reciprocalW
+    );
+
+    Span span = {
+        .reciprocalWStepX = reciprocalW.stepX,
+        .uOverWStepX = uOverW.stepX,
+        .vOverWStepX = vOverW.stepX,
+        .texture = texture,
+        .textureWidth = textureWidth,
+        .textureHeight = textureHeight,
+        .stats = stats,
+    };
+    beginSpan(&span, &edges);
+    for (int y = edges.minY; y <= edges.maxY; y++) {
+        const int row = y - edges.minY;
+        span.reciprocalW = gradientRowValue(&reciprocalW, row);
+        span.uOverW = gradientRowValue(&uOverW, row);
+        span.vOverW = gradientRowValue(&vOverW, row);
+        drawTexturedSpan(&span);
+
+        nextSpan(&span, &edges);
+    }
 }
-
@@ -9,6 +9,7 @@
 
 #include "vector.h"
 #include "texture.h"
+#include "stats.h"
 
 typedef struct Face {
     int a, b, c;
@@ -18,37 +19,43 @@ typedef struct Face {
     Texture2 vertexC_UV;
 } Face;
 
+// inclusive pixel rectangle the rasterizer is allowed to write to
+typedef struct {
+    int minX, minY;
+    int maxX, maxY;
+} ClipRect;
+
 typedef struct Triangle {
     Vec4 points[3];
     Texture2 textCoords[3];
     uint32_t color;
 } Triangle;
 
-void drawFilledTriangle(
-    int x0, int y0, float z0, float w0,
-    int x1, int y1, float z1, float w1,
-    int x2, int y2, float z2, float w2,
-    uint32_t color
-);
-
-void drawTrianglePixel(
-    int x, int y, uint32_t color,
-    Vec4 pointA, Vec4 pointB, Vec4 pointC
-);
+///////////////////////////////////////////////////////////////////////////////
+// A projected vertex in the form the rasterizer consumes it. x and y are the
+// whole pixels the edge functions work with, the texture coordinates have V
+// already flipped. 16 bytes instead of the 24 of a Vec4 and a Texture2.
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    int16_t x, y;
+    float u, v;
+    float reciprocalW;  // 1/w, the depth and the perspective correction
+} ScreenVertex;
+
+// a triangle of the render queue, 52 bytes
+typedef struct {
+    ScreenVertex vertices[3];
+    uint32_t color;
+} ScreenTriangle;
 
-void drawTexel(
-    int x, int y, const uint32_t *texture,
-    Vec4 pointA, Vec4 pointB, Vec4 pointC,
-    Texture2 vertexA_UV, Texture2 vertexB_UV, Texture2 vertexC_UV
-);
+ScreenVertex packScreenVertex(Vec4 projectedPoint, Texture2 textCoord);
 
+// the depth test and texel counts of the triangle are added to stats
+void drawFilledTriangle(const ScreenTriangle *triangle, ClipRect clipRect, PipelineStats *stats);
 void drawTexturedTriangle(
-    int x0, int y0, float z0, float w0, float u0, float v0,
-    int x1, int y1, float z1, float w1, float u1, float v1,
-    int x2, int y2, float z2, float w2, float u2, float v2,
-    uint32_t *texture
+    const ScreenTriangle *triangle, const uint32_t *texture, ClipRect clipRect, PipelineStats *stats
 );
-
-Vec3 barycentricWeights(Vec2 a, Vec2 b, Vec2 c, Vec2 p);
+// counts the pixels the triangle shades into the color buffer, for RENDER_OVERDRAW
+void drawOverdrawTriangle(const ScreenTriangle *triangle, ClipRect clipRect, PipelineStats *stats);
 
 #endif //TRIANGLE_H
@@ -28,7 +28,10 @@ freely, subject to the following restrictions:
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
 
+#include "simd.h"
 #include "upng.h"
 
 #define MAKE_BYTE(b) ((b) & 0xFF)
@@ -52,6 +55,9 @@ freely, subject to the following restrictions:
 #define CODE_LENGTH_BITLEN 7
 #define MAX_BIT_LENGTH 15 /* largest bitlen used by any tree type */
 
+#define HUFFMAN_TABLE_BITS 10 /* bits resolved by one table lookup, longer codes are rare */
+#define HUFFMAN_TABLE_SIZE (1 << HUFFMAN_TABLE_BITS)
+
 #define DEFLATE_CODE_BUFFER_SIZE (NUM_DEFLATE_CODE_SYMBOLS * 2)
 #define DISTANCE_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
 #define CODE_LENGTH_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
@@ -100,12 +106,23 @@ struct upng_t {
     upng_source		source;
 };
 
+/* a symbol is looked up with the next HUFFMAN_TABLE_BITS bits of the stream. An entry holds the symbol << 4 | the length of its code, 0 for codes that are longer or broken, those walk tree2d bit by bit */
 typedef struct huffman_tree {
     unsigned* tree2d;
     unsigned maxbitlen;	/*maximum number of bits a single code can get */
     unsigned numcodes;	/*number of symbols in the alphabet = number of codes */
+    unsigned short table[HUFFMAN_TABLE_SIZE];
 } huffman_tree;
 
+/* the next bits of the deflate stream, least significant bit first. The buffer is refilled 8 bytes at a time, past the end of the input with zeros, which bit_reader_overrun tells from real bits */
+typedef struct bit_reader {
+    const unsigned char* in;
+    unsigned long size;	/*bytes in the stream */
+    unsigned long pos;	/*next byte to move into the buffer, may pass size */
+    uint64_t bits;
+    unsigned count;	/*valid bits in the buffer */
+} bit_reader;
+
 static const unsigned LENGTH_BASE[29] = {	/*the base lengths represented by codes 257-285 */
     3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
     67, 83, 99, 115, 131, 163, 195, 227, 258
@@ -176,21 +193,71 @@ static const unsigned FIXED_DISTANCE_TREE[NUM_DISTANCE_SYMBOLS * 2] = {
     29, 30, 31, 0, 0
 };
 
-static unsigned char read_bit(unsigned long *bitpointer, const unsigned char *bitstream)
+static void bit_reader_init(bit_reader* reader, const unsigned char* in, unsigned long size)
 {
-    unsigned char result = (unsigned char)((bitstream[(*bitpointer) >> 3] >> ((*bitpointer) & 0x7)) & 1);
-    (*bitpointer)++;
-    return result;
+    reader->in = in;
+    reader->size = size;
+    reader->pos = 0;
+    reader->bits = 0;
+    reader->count = 0;
+}
+
+/* top the buffer up to at least 56 bits */
+static void bit_reader_refill(bit_reader* reader)
+{
+    if (reader->pos + 8 <= reader->size) {
+        /* the bits above count get the same bytes again, ORing them in changes nothing */
+        uint64_t word;
+        memcpy(&word, reader->in + reader->pos, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        reader->bits |= word << reader->count;
+        reader->pos += (63 - reader->count) >> 3;
+        reader->count |= 56;
+    } else {
+        while (reader->count < 56) {
+            uint64_t byte = reader->pos < reader->size ? reader->in[reader->pos] : 0;
+            reader->bits |= byte << reader->count;
+            reader->pos++;
+            reader->count += 8;
+        }
+    }
+}
+
+/* whether more bits were taken than the stream has */
+static int bit_reader_overrun(const bit_reader* reader)
+{
+    return (reader->pos << 3) - reader->count > (reader->size << 3);
+}
+
+static void bit_reader_consume(bit_reader* reader, unsigned nbits)
+{
+    reader->bits >>= nbits;
+    reader->count -= nbits;
 }
 
-static unsigned read_bits(unsigned long *bitpointer, const unsigned char *bitstream, unsigned long nbits)
+/* nbits is at most 56 */
+static unsigned read_bits(bit_reader* reader, unsigned nbits)
 {
-    unsigned result = 0, i;
-    for (i = 0; i < nbits; i++)
-        result |= ((unsigned)read_bit(bitpointer, bitstream)) << i;
+    unsigned result;
+    if (reader->count < nbits) {
+        bit_reader_refill(reader);
+    }
+    result = (unsigned)(reader->bits & ((1ull << nbits) - 1));
+    bit_reader_consume(reader, nbits);
     return result;
 }
 
+/* drop the bits up to the next byte boundary and return the position of that byte, the buffer is empty afterwards */
+static unsigned long bit_reader_align(bit_reader* reader)
+{
+    reader->pos -= reader->count >> 3;
+    reader->bits = 0;
+    reader->count = 0;
+    return reader->pos;
+}
+
 /* the buffer must be numcodes*2 in size! */
 static void huffman_tree_init(huffman_tree* tree, unsigned* buffer, unsigned numcodes, unsigned maxbitlen)
 {
@@ -200,6 +267,33 @@ static void huffman_tree_init(huffman_tree* tree, unsigned* buffer, unsigned num
     tree->maxbitlen = maxbitlen;
 }
 
+/* fill the table entries of the nodes below treepos, path holds the depth bits that lead there. The walk stops at HUFFMAN_TABLE_BITS, so a broken tree cannot loop */
+static void huffman_tree_fill_table(huffman_tree* tree, unsigned treepos, unsigned depth, unsigned path)
+{
+    unsigned bit;
+    for (bit = 0; bit < 2; bit++) {
+        unsigned ct = tree->tree2d[(treepos << 1) | bit];
+        unsigned code = path | (bit << depth);
+        if (ct < tree->numcodes) {
+            /* every index that starts with the code */
+            unsigned short entry = (unsigned short)((ct << 4) | (depth + 1));
+            unsigned n;
+            for (n = code; n < HUFFMAN_TABLE_SIZE; n += 1u << (depth + 1)) {
+                tree->table[n] = entry;
+            }
+        } else if (ct - tree->numcodes < tree->numcodes && depth + 1 < HUFFMAN_TABLE_BITS) {
+            huffman_tree_fill_table(tree, ct - tree->numcodes, depth + 1, code);
+        }
+    }
+}
+
+/* build the lookup table from tree2d, so the table decodes exactly what walking the tree does */
+static void huffman_tree_create_table(huffman_tree* tree)
+{
+    memset(tree->table, 0, sizeof(tree->table));
+    huffman_tree_fill_table(tree, 0, 0, 0);
+}
+
 /*given the code lengths (as stored in the PNG file), generate the tree as defined by Deflate. maxbitlen is the maximum bits that a code in the tree can have. return value is error.*/
 static void huffman_tree_create_lengths(upng_t* upng, huffman_tree* tree, const unsigned *bitlen)
 {
@@ -266,22 +360,22 @@ static void huffman_tree_create_lengths(upng_t* upng, huffman_tree* tree, const
             tree->tree2d[n] = 0;	/*remove possible remaining 32767's */
         }
     }
+
+    huffman_tree_create_table(tree);
 }
 
-static unsigned huffman_decode_symbol(upng_t *upng, const unsigned char *in, unsigned long *bp, const huffman_tree* codetree, unsigned long inlength)
+/* walk the tree bit by bit, for the codes longer than the table and the errors */
+static unsigned huffman_decode_symbol_slow(upng_t *upng, bit_reader* reader, const huffman_tree* codetree)
 {
     unsigned treepos = 0, ct;
-    unsigned char bit;
     for (;;) {
         /* error: end of input memory reached without endcode */
-        if (((*bp) & 0x07) == 0 && ((*bp) >> 3) > inlength) {
+        if (bit_reader_overrun(reader)) {
             SET_ERROR(upng, UPNG_EMALFORMED);
             return 0;
         }
 
-        bit = read_bit(bp, in);
-
-        ct = codetree->tree2d[(treepos << 1) | bit];
+        ct = codetree->tree2d[(treepos << 1) | read_bits(reader, 1)];
         if (ct < codetree->numcodes) {
             return ct;
         }
@@ -294,8 +388,23 @@ static unsigned huffman_decode_symbol(upng_t *upng, const unsigned char *in, uns
     }
 }
 
+static unsigned huffman_decode_symbol(upng_t *upng, bit_reader* reader, const huffman_tree* codetree)
+{
+    unsigned entry;
+    if (reader->count < MAX_BIT_LENGTH) {
+        bit_reader_refill(reader);
+    }
+
+    entry = codetree->table[reader->bits & (HUFFMAN_TABLE_SIZE - 1)];
+    if (entry == 0) {
+        return huffman_decode_symbol_slow(upng, reader, codetree);
+    }
+    bit_reader_consume(reader, entry & 15);
+    return entry >> 4;
+}
+
 /* get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
-static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffman_tree* codetreeD, huffman_tree* codelengthcodetree, const unsigned char *in, unsigned long *bp, unsigned long inlength)
+static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffman_tree* codetreeD, huffman_tree* codelengthcodetree, bit_reader* reader)
 {
     unsigned codelengthcode[NUM_CODE_LENGTH_CODES];
     unsigned bitlen[NUM_DEFLATE_CODE_SYMBOLS];
@@ -304,7 +413,7 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 
     /*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated */
     /*C-code note: use no "return" between ctor and dtor of an uivector! */
-    if ((*bp) >> 3 >= inlength - 2) {
+    if (bit_reader_overrun(reader)) {
         SET_ERROR(upng, UPNG_EMALFORMED);
         return;
     }
@@ -314,13 +423,13 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
     memset(bitlenD, 0, sizeof(bitlenD));
 
     /*the bit pointer is or will go past the memory */
-    hlit = read_bits(bp, in, 5) + 257;	/*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already */
-    hdist = read_bits(bp, in, 5) + 1;	/*number of distance codes. Unlike the spec, the value 1 is added to it here already */
-    hclen = read_bits(bp, in, 4) + 4;	/*number of code length codes. Unlike the spec, the value 4 is added to it here already */
+    hlit = read_bits(reader, 5) + 257;	/*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already */
+    hdist = read_bits(reader, 5) + 1;	/*number of distance codes. Unlike the spec, the value 1 is added to it here already */
+    hclen = read_bits(reader, 4) + 4;	/*number of code length codes. Unlike the spec, the value 4 is added to it here already */
 
     for (i = 0; i < NUM_CODE_LENGTH_CODES; i++) {
         if (i < hclen) {
-            codelengthcode[CLCL[i]] = read_bits(bp, in, 3);
+            codelengthcode[CLCL[i]] = read_bits(reader, 3);
         } else {
             codelengthcode[CLCL[i]] = 0;	/*if not, it must stay 0 */
         }
@@ -336,7 +445,7 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
     /*now we can use this tree to read the lengths for the tree that this function will return */
     i = 0;
     while (i < hlit + hdist) {	/*i is the current symbol we're reading in the part that contains the code lengths of lit/len codes and dist codes */
-        unsigned code = huffman_decode_symbol(upng, in, bp, codelengthcodetree, inlength);
+        unsigned code = huffman_decode_symbol(upng, reader, codelengthcodetree);
         if (upng->error != UPNG_EOK) {
             break;
         }
@@ -352,12 +461,18 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
             unsigned replength = 3;	/*read in the 2 bits that indicate repeat length (3-6) */
             unsigned value;	/*set value to the previous code */
 
-            if ((*bp) >> 3 >= inlength) {
+            if (bit_reader_overrun(reader)) {
                 SET_ERROR(upng, UPNG_EMALFORMED);
                 break;
             }
             /*error, bit pointer jumps past memory */
-            replength += read_bits(bp, in, 2);
+            replength += read_bits(reader, 2);
+
+            /* there is no previous code to repeat */
+            if (i == 0) {
+                SET_ERROR(upng, UPNG_EMALFORMED);
+                break;
+            }
 
             if ((i - 1) < hlit) {
                 value = bitlen[i - 1];
@@ -382,13 +497,13 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
             }
         } else if (code == 17) {	/*repeat "0" 3-10 times */
             unsigned replength = 3;	/*read in the bits that indicate repeat length */
-            if ((*bp) >> 3 >= inlength) {
+            if (bit_reader_overrun(reader)) {
                 SET_ERROR(upng, UPNG_EMALFORMED);
                 break;
             }
 
             /*error, bit pointer jumps past memory */
-            replength += read_bits(bp, in, 3);
+            replength += read_bits(reader, 3);
 
             /*repeat this value in the next lengths */
             for (n = 0; n < replength; n++) {
@@ -408,12 +523,12 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
         } else if (code == 18) {	/*repeat "0" 11-138 times */
             unsigned replength = 11;	/*read in the bits that indicate repeat length */
             /* error, bit pointer jumps past memory */
-            if ((*bp) >> 3 >= inlength) {
+            if (bit_reader_overrun(reader)) {
                 SET_ERROR(upng, UPNG_EMALFORMED);
                 break;
             }
 
-            replength += read_bits(bp, in, 7);
+            replength += read_bits(reader, 7);
 
             /*repeat this value in the next lengths */
             for (n = 0; n < replength; n++) {
@@ -450,7 +565,7 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 }
 
 /*inflate a block with dynamic of fixed Huffman tree*/
-static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long *bp, unsigned long *pos, unsigned long inlength, unsigned btype)
+static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outsize, bit_reader* reader, unsigned long *pos, unsigned btype)
 {
     unsigned codetree_buffer[DEFLATE_CODE_BUFFER_SIZE];
     unsigned codetreeD_buffer[DISTANCE_BUFFER_SIZE];
@@ -463,6 +578,8 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
         /* fixed trees */
         huffman_tree_init(&codetree, (unsigned*)FIXED_DEFLATE_CODE_TREE, NUM_DEFLATE_CODE_SYMBOLS, DEFLATE_CODE_BITLEN);
         huffman_tree_init(&codetreeD, (unsigned*)FIXED_DISTANCE_TREE, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
+        huffman_tree_create_table(&codetree);
+        huffman_tree_create_table(&codetreeD);
     } else if (btype == 2) {
         /* dynamic trees */
         unsigned codelengthcodetree_buffer[CODE_LENGTH_BUFFER_SIZE];
@@ -471,11 +588,22 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
         huffman_tree_init(&codetree, codetree_buffer, NUM_DEFLATE_CODE_SYMBOLS, DEFLATE_CODE_BITLEN);
         huffman_tree_init(&codetreeD, codetreeD_buffer, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
         huffman_tree_init(&codelengthcodetree, codelengthcodetree_buffer, NUM_CODE_LENGTH_CODES, CODE_LENGTH_BITLEN);
-        get_tree_inflate_dynamic(upng, &codetree, &codetreeD, &codelengthcodetree, in, bp, inlength);
+        get_tree_inflate_dynamic(upng, &codetree, &codetreeD, &codelengthcodetree, reader);
+        if (upng->error != UPNG_EOK) {
+            return;
+        }
     }
 
     while (done == 0) {
-        unsigned code = huffman_decode_symbol(upng, in, bp, &codetree, inlength);
+        unsigned code;
+
+        /* error: end of input memory reached without endcode */
+        if (bit_reader_overrun(reader)) {
+            SET_ERROR(upng, UPNG_EMALFORMED);
+            return;
+        }
+
+        code = huffman_decode_symbol(upng, reader, &codetree);
         if (upng->error != UPNG_EOK) {
             return;
         }
@@ -496,20 +624,14 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
             /* part 1: get length base */
             unsigned long length = LENGTH_BASE[code - FIRST_LENGTH_CODE_INDEX];
             unsigned codeD, distance, numextrabitsD;
-            unsigned long start, forward, backward, numextrabits;
+            unsigned long start, forward, numextrabits;
 
             /* part 2: get extra bits and add the value of that to length */
             numextrabits = LENGTH_EXTRA[code - FIRST_LENGTH_CODE_INDEX];
-
-            /* error, bit pointer will jump past memory */
-            if (((*bp) >> 3) >= inlength) {
-                SET_ERROR(upng, UPNG_EMALFORMED);
-                return;
-            }
-            length += read_bits(bp, in, numextrabits);
+            length += read_bits(reader, numextrabits);
 
             /*part 3: get distance code */
-            codeD = huffman_decode_symbol(upng, in, bp, &codetreeD, inlength);
+            codeD = huffman_decode_symbol(upng, reader, &codetreeD);
             if (upng->error != UPNG_EOK) {
                 return;
             }
@@ -524,49 +646,55 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 
             /*part 4: get extra bits from distance */
             numextrabitsD = DISTANCE_EXTRA[codeD];
-
-            /* error, bit pointer will jump past memory */
-            if (((*bp) >> 3) >= inlength) {
-                SET_ERROR(upng, UPNG_EMALFORMED);
-                return;
-            }
-
-            distance += read_bits(bp, in, numextrabitsD);
+            distance += read_bits(reader, numextrabitsD);
 
             /*part 5: fill in all the out[n] values based on the length and dist */
             start = (*pos);
-            backward = start - distance;
 
-            if ((*pos) + length >= outsize) {
+            /* error, the distance points before the start of the output, or the length past its end */
+            if (distance > start || start + length > outsize) {
                 SET_ERROR(upng, UPNG_EMALFORMED);
                 return;
             }
 
-            for (forward = 0; forward < length; forward++) {
-                out[(*pos)++] = out[backward];
-                backward++;
-
-                if (backward >= start) {
-                    backward = start - distance;
+            if (distance >= 8 && start + length + 8 <= outsize) {
+                /* whole words, the bytes written past the match are written again later */
+                for (forward = 0; forward < length; forward += 8) {
+                    memcpy(out + start + forward, out + start + forward - distance, 8);
+                }
+            } else if (distance >= length) {
+                memcpy(out + start, out + start - distance, length);
+            } else {
+                /* the copy overlaps what it writes, repeating the last distance bytes */
+                for (forward = 0; forward < length; forward++) {
+                    out[start + forward] = out[start + forward - distance];
                 }
             }
+            (*pos) = start + length;
+        } else {
+            /* the unused length codes 286 and 287 */
+            SET_ERROR(upng, UPNG_EMALFORMED);
+            return;
         }
     }
+
+    if (bit_reader_overrun(reader)) {
+        SET_ERROR(upng, UPNG_EMALFORMED);
+    }
 }
 
-static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long *bp, unsigned long *pos, unsigned long inlength)
+static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long outsize, bit_reader* reader, unsigned long *pos)
 {
+    const unsigned char* in = reader->in;
+    unsigned long inlength = reader->size;
     unsigned long p;
-    unsigned len, nlen, n;
+    unsigned len, nlen;
 
     /* go to first boundary of byte */
-    while (((*bp) & 0x7) != 0) {
-        (*bp)++;
-    }
-    p = (*bp) / 8;		/*byte position */
+    p = bit_reader_align(reader);	/*byte position */
 
     /* read len (2 bytes) and nlen (2 bytes) */
-    if (p >= inlength - 4) {
+    if (p + 4 > inlength) {
         SET_ERROR(upng, UPNG_EMALFORMED);
         return;
     }
@@ -582,7 +710,7 @@ static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long
         return;
     }
 
-    if ((*pos) + len >= outsize) {
+    if ((*pos) + len > outsize) {
         SET_ERROR(upng, UPNG_EMALFORMED);
         return;
     }
@@ -593,42 +721,43 @@ static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long
         return;
     }
 
-    for (n = 0; n < len; n++) {
-        out[(*pos)++] = in[p++];
-    }
+    memcpy(out + (*pos), in + p, len);
+    (*pos) += len;
 
-    (*bp) = p * 8;
+    reader->pos = p + len;
 }
 
 /*inflate the deflated data (cfr. deflate spec); return value is the error*/
 static upng_error uz_inflate_data(upng_t* upng, unsigned char* out, unsigned long outsize, const unsigned char *in, unsigned long insize, unsigned long inpos)
 {
-    unsigned long bp = 0;	/*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte) */
+    bit_reader reader;	/*the bits of the "in" data after the zlib header */
     unsigned long pos = 0;	/*byte position in the out buffer */
 
     unsigned done = 0;
 
+    bit_reader_init(&reader, &in[inpos], insize - inpos);
+
     while (done == 0) {
         unsigned btype;
 
-        /* ensure next bit doesn't point past the end of the buffer */
-        if ((bp >> 3) >= insize) {
+        /* read block control bits */
+        done = read_bits(&reader, 1);
+        btype = read_bits(&reader, 2);
+
+        /* ensure the control bits didn't point past the end of the buffer */
+        if (bit_reader_overrun(&reader)) {
             SET_ERROR(upng, UPNG_EMALFORMED);
             return upng->error;
         }
 
-        /* read block control bits */
-        done = read_bit(&bp, &in[inpos]);
-        btype = read_bit(&bp, &in[inpos]) | (read_bit(&bp, &in[inpos]) << 1);
-
         /* process control type appropriateyly */
         if (btype == 3) {
             SET_ERROR(upng, UPNG_EMALFORMED);
             return upng->error;
         } else if (btype == 0) {
-            inflate_uncompressed(upng, out, outsize, &in[inpos], &bp, &pos, insize);	/*no compression */
+            inflate_uncompressed(upng, out, outsize, &reader, &pos);	/*no compression */
         } else {
-            inflate_huffman(upng, out, outsize, &in[inpos], &bp, &pos, insize, btype);	/*compression, btype 01 or 10 */
+            inflate_huffman(upng, out, outsize, &reader, &pos, btype);	/*compression, btype 01 or 10 */
         }
 
         /* stop if an error has occured */
@@ -750,6 +879,89 @@ static void unfilter_scanline(upng_t* upng, unsigned char *recon, const unsigned
     }
 }
 
+#if SIMD_X86
+/*
+   SSE4.1 unfiltering for 3 and 4 bytes per pixel, the RGB8 and RGBA8 images. Up adds 16 bytes at a time. Sub, Average and Paeth depend on the pixel to the left, so they go a pixel at a time with all its bytes in one register, and only the left pixel is kept on the dependency chain.
+   Average keeps the complement of the left pixel, avg_epu8 of the complements is the complement of the rounded down average the filter uses.
+   Paeth picks without branches: with p = a + b - c, the distances |p - a|, |p - b| and |p - c| are |b - c|, |a - c| and |b - c + a - c|, computed in 16 bits, and the compare masks prefer a, then b, then c as paeth_predictor does on ties.
+   Only the scanlines after the first one come here, precon is never NULL.
+ */
+SIMD_TARGET("sse4.1")
+static __m128i load_pixel(const unsigned char *p, unsigned long bytewidth)
+{
+    int pixel = 0;
+    /* constant sizes, so the copies are plain moves */
+    if (bytewidth == 4)
+        memcpy(&pixel, p, 4);
+    else
+        memcpy(&pixel, p, 3);
+    return _mm_cvtsi32_si128(pixel);
+}
+
+SIMD_TARGET("sse4.1")
+static void store_pixel(unsigned char *p, __m128i pixel, unsigned long bytewidth)
+{
+    int value = _mm_cvtsi128_si32(pixel);
+    if (bytewidth == 4)
+        memcpy(p, &value, 4);
+    else
+        memcpy(p, &value, 3);
+}
+
+SIMD_TARGET("sse4.1")
+static void unfilter_scanline_sse41(unsigned char *recon, const unsigned char *scanline, const unsigned char *precon, unsigned long bytewidth, unsigned char filterType, unsigned long length)
+{
+    const __m128i ones = _mm_set1_epi8(-1);
+    const __m128i low_bytes = _mm_set1_epi16(0xff);
+    __m128i a = _mm_setzero_si128(), c = _mm_setzero_si128();	/*the pixels to the left and up left */
+    unsigned long i = 0;
+
+    switch (filterType) {
+        case 1:
+            for (; i < length; i += bytewidth) {
+                a = _mm_add_epi8(a, load_pixel(&scanline[i], bytewidth));
+                store_pixel(&recon[i], a, bytewidth);
+            }
+            break;
+        case 2:
+            for (; i + 16 <= length; i += 16) {
+                __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+                __m128i b = _mm_loadu_si128((const __m128i*)&precon[i]);
+                _mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(x, b));
+            }
+            for (; i < length; i++)
+                recon[i] = scanline[i] + precon[i];
+            break;
+        case 3:
+            a = ones;	/*the complement of the left pixel */
+            for (; i < length; i += bytewidth) {
+                __m128i b = _mm_xor_si128(load_pixel(&precon[i], bytewidth), ones);
+                a = _mm_sub_epi8(_mm_avg_epu8(a, b), load_pixel(&scanline[i], bytewidth));
+                store_pixel(&recon[i], _mm_xor_si128(a, ones), bytewidth);
+            }
+            break;
+        case 4:
+            /* 16 bits per byte */
+            for (; i < length; i += bytewidth) {
+                __m128i b = _mm_cvtepu8_epi16(load_pixel(&precon[i], bytewidth));
+                __m128i x = _mm_cvtepu8_epi16(load_pixel(&scanline[i], bytewidth));
+                __m128i bc = _mm_sub_epi16(b, c);
+                __m128i pa = _mm_abs_epi16(bc);
+                __m128i ac = _mm_sub_epi16(a, c);
+                __m128i pb = _mm_abs_epi16(ac);
+                __m128i pc = _mm_abs_epi16(_mm_add_epi16(bc, ac));
+                __m128i predictor = _mm_blendv_epi8(b, c, _mm_cmpgt_epi16(pb, pc));
+                predictor = _mm_blendv_epi8(a, predictor, _mm_cmpgt_epi16(pa, _mm_min_epi16(pb, pc)));
+
+                a = _mm_and_si128(_mm_add_epi16(predictor, x), low_bytes);
+                store_pixel(&recon[i], _mm_packus_epi16(a, a), bytewidth);
+                c = b;
+            }
+            break;
+    }
+}
+#endif
+
 static void unfilter(upng_t* upng, unsigned char *out, const unsigned char *in, unsigned w, unsigned h, unsigned bpp)
 {
     /*
@@ -765,12 +977,22 @@ static void unfilter(upng_t* upng, unsigned char *out, const unsigned char *in,
 
     unsigned long bytewidth = (bpp + 7) / 8;	/*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise */
     unsigned long linebytes = (w * bpp + 7) / 8;
+#if SIMD_X86
+    int use_sse41 = (bytewidth == 3 || bytewidth == 4) && SDL_HasSSE41();
+#endif
 
     for (y = 0; y < h; y++) {
         unsigned long outindex = linebytes * y;
         unsigned long inindex = (1 + linebytes) * y;	/*the extra filterbyte added to each row */
         unsigned char filterType = in[inindex];
 
+#if SIMD_X86
+        if (use_sse41 && prevline != 0 && filterType >= 1 && filterType <= 4) {
+            unfilter_scanline_sse41(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes);
+            prevline = &out[outindex];
+            continue;
+        }
+#endif
         unfilter_scanline(upng, &out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes);
         if (upng->error != UPNG_EOK) {
             return;
@@ -961,7 +1183,8 @@ upng_error upng_header(upng_t* upng)
 }
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-upng_error upng_decode(upng_t* upng)
+/* read the IDAT chunks of the source and inflate them, returns the still filtered scanlines to be freed by the caller, NULL on errors */
+static unsigned char* inflate_image(upng_t* upng)
 {
     const unsigned char *chunk;
     unsigned char* compressed;
@@ -970,29 +1193,6 @@ upng_error upng_decode(upng_t* upng)
     unsigned long inflated_size;
     upng_error error;
 
-    /* if we have an error state, bail now */
-    if (upng->error != UPNG_EOK) {
-        return upng->error;
-    }
-
-    /* parse the main header, if necessary */
-    upng_header(upng);
-    if (upng->error != UPNG_EOK) {
-        return upng->error;
-    }
-
-    /* if the state is not HEADER (meaning we are ready to decode the image), stop now */
-    if (upng->state != UPNG_HEADER) {
-        return upng->error;
-    }
-
-    /* release old result, if any */
-    if (upng->buffer != 0) {
-        free(upng->buffer);
-        upng->buffer = 0;
-        upng->size = 0;
-    }
-
     /* first byte of the first chunk after the header */
     chunk = upng->source.buffer + 33;
 
@@ -1005,20 +1205,20 @@ upng_error upng_decode(upng_t* upng)
         /* make sure chunk header is not larger than the total compressed */
         if ((unsigned long)(chunk - upng->source.buffer + 12) > upng->source.size) {
             SET_ERROR(upng, UPNG_EMALFORMED);
-            return upng->error;
+            return NULL;
         }
 
         /* get length; sanity check it */
         length = upng_chunk_length(chunk);
         if (length > INT_MAX) {
             SET_ERROR(upng, UPNG_EMALFORMED);
-            return upng->error;
+            return NULL;
         }
 
         /* make sure chunk header+paylaod is not larger than the total compressed */
         if ((unsigned long)(chunk - upng->source.buffer + length + 12) > upng->source.size) {
             SET_ERROR(upng, UPNG_EMALFORMED);
-            return upng->error;
+            return NULL;
         }
 
         /* get pointer to payload */
@@ -1031,7 +1231,7 @@ upng_error upng_decode(upng_t* upng)
             break;
         } else if (upng_chunk_critical(chunk)) {
             SET_ERROR(upng, UPNG_EUNSUPPORTED);
-            return upng->error;
+            return NULL;
         }
 
         chunk += upng_chunk_length(chunk) + 12;
@@ -1041,7 +1241,7 @@ upng_error upng_decode(upng_t* upng)
     compressed = (unsigned char*)malloc(compressed_size);
     if (compressed == NULL) {
         SET_ERROR(upng, UPNG_ENOMEM);
-        return upng->error;
+        return NULL;
     }
 
     /* scan through the chunks again, this time copying the values into
@@ -1071,7 +1271,7 @@ upng_error upng_decode(upng_t* upng)
     if (inflated == NULL) {
         free(compressed);
         SET_ERROR(upng, UPNG_ENOMEM);
-        return upng->error;
+        return NULL;
     }
 
     /* decompress image data */
@@ -1079,12 +1279,47 @@ upng_error upng_decode(upng_t* upng)
     if (error != UPNG_EOK) {
         free(compressed);
         free(inflated);
-        return upng->error;
+        return NULL;
     }
 
     /* free the compressed compressed data */
     free(compressed);
 
+    return inflated;
+}
+
+upng_error upng_decode(upng_t* upng)
+{
+    unsigned char* inflated;
+
+    /* if we have an error state, bail now */
+    if (upng->error != UPNG_EOK) {
+        return upng->error;
+    }
+
+    /* parse the main header, if necessary */
+    upng_header(upng);
+    if (upng->error != UPNG_EOK) {
+        return upng->error;
+    }
+
+    /* if the state is not HEADER (meaning we are ready to decode the image), stop now */
+    if (upng->state != UPNG_HEADER) {
+        return upng->error;
+    }
+
+    /* release old result, if any */
+    if (upng->buffer != 0) {
+        free(upng->buffer);
+        upng->buffer = 0;
+        upng->size = 0;
+    }
+
+    inflated = inflate_image(upng);
+    if (inflated == NULL) {
+        return upng->error;
+    }
+
     /* allocate final image buffer */
     upng->size = (upng->height * upng->width * upng_get_bpp(upng) + 7) / 8;
     upng->buffer = (unsigned char*)malloc(upng->size);
@@ -1113,6 +1348,94 @@ upng_error upng_decode(upng_t* upng)
     return upng->error;
 }
 
+/* expand count pixels of components channels of channelsize bytes to R, G, B, A. 16 bit channels keep their high byte, which comes first */
+static void expand_to_rgba32(unsigned char* out, const unsigned char* in, unsigned long count, unsigned components, unsigned channelsize)
+{
+    unsigned long i;
+    for (i = 0; i < count; i++) {
+        switch (components) {
+            case 1:
+                out[0] = out[1] = out[2] = in[0];
+                out[3] = 255;
+                break;
+            case 2:
+                out[0] = out[1] = out[2] = in[0];
+                out[3] = in[channelsize];
+                break;
+            case 3:
+                out[0] = in[0];
+                out[1] = in[channelsize];
+                out[2] = in[2 * channelsize];
+                out[3] = 255;
+                break;
+            default:
+                out[0] = in[0];
+                out[1] = in[channelsize];
+                out[2] = in[2 * channelsize];
+                out[3] = in[3 * channelsize];
+                break;
+        }
+        out += 4;
+        in += components * channelsize;
+    }
+}
+
+upng_error upng_decode_rgba32(upng_t* upng, unsigned char* out)
+{
+    unsigned char* inflated;
+    unsigned components, depth;
+
+    /* if we have an error state, bail now */
+    if (upng->error != UPNG_EOK) {
+        return upng->error;
+    }
+
+    /* parse the main header, if necessary */
+    upng_header(upng);
+    if (upng->error != UPNG_EOK) {
+        return upng->error;
+    }
+
+    /* if the state is not HEADER (meaning we are ready to decode the image), stop now */
+    if (upng->state != UPNG_HEADER) {
+        return upng->error;
+    }
+
+    /* the pixels below 8 bits would have to be unpacked first */
+    components = upng_get_components(upng);
+    depth = upng_get_bitdepth(upng);
+    if (components == 0 || (depth != 8 && depth != 16)) {
+        SET_ERROR(upng, UPNG_EUNFORMAT);
+        return upng->error;
+    }
+
+    inflated = inflate_image(upng);
+    if (inflated == NULL) {
+        return upng->error;
+    }
+
+    if (upng->format == UPNG_RGBA8) {
+        /* already the layout of out */
+        unfilter(upng, out, inflated, upng->width, upng->height, 32);
+    } else {
+        /* unfilter in place, then spread the pixels out */
+        unfilter(upng, inflated, inflated, upng->width, upng->height, components * depth);
+        if (upng->error == UPNG_EOK) {
+            expand_to_rgba32(out, inflated, (unsigned long)upng->width * upng->height, components, depth / 8);
+        }
+    }
+    free(inflated);
+
+    if (upng->error == UPNG_EOK) {
+        upng->state = UPNG_DECODED;
+    }
+
+    /* we are done with our input buffer; free it if we own it */
+    upng_free_source(upng);
+
+    return upng->error;
+}
+
 static upng_t* upng_new(void)
 {
     upng_t* upng;
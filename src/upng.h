@@ -63,6 +63,8 @@ void		upng_free			(upng_t* upng);
 
 upng_error	upng_header			(upng_t* upng);
 upng_error	upng_decode			(upng_t* upng);
+/* decode into out, width * height pixels of 4 bytes in R, G, B, A order, expanding RGB, luminance and 16 bit images. out is the caller's, upng_get_buffer stays NULL. Images below 8 bits per channel are UPNG_EUNFORMAT */
+upng_error	upng_decode_rgba32	(upng_t* upng, unsigned char* out);
 
 upng_error	upng_get_error		(const upng_t* upng);
 unsigned	upng_get_error_line	(const upng_t* upng);